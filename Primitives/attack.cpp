@@ -3,10 +3,12 @@
 #include "attack.h"
 
 // Helper function
-bitstr rand_bitstr(size_type size) {
+bitstr rand_bitstr(size_type size, prng& gen) {
   bitstr result(size);
-  for (size_type i = 0; i < size; ++i) {
-      result[i] = rand() % 2; // Randomly set bits to 0 or 1
+  size_type words = (size + bitstr::BITS_PER_BLOCK - 1) / bitstr::BITS_PER_BLOCK;
+  for (size_type w = 0; w < words; ++w) {
+    size_type left = size - w * bitstr::BITS_PER_BLOCK;
+    result.blocks[w] = gen.bits(std::min<size_type>(left, bitstr::BITS_PER_BLOCK));
   }
   return result;
 }
@@ -79,12 +81,16 @@ std::vector<float> walsh_transform(bool* input, size_type size) {
   return walsh_transform(input_vector);
 }
 
-// Constructor
-attack::attack(const bitstr &pt_mask, const bitstr &ct_mask, const bitstr &key_mask, float bias, size_type rounds, feistel cipher) {
+// Constructors
+attack::attack(const bitstr &pt_mask, const bitstr &ct_mask, const bitstr &key_mask, float bias, size_type rounds, const feistel_ctx& ctx, uint64_t seed) : gen(seed) {
+  if (!ctx.cipher || !ctx.sched) throw std::invalid_argument("Invalid cipher context");
+  cipher = ctx.cipher;
+  this->ctx = ctx;
+
   // Few assertions to be checked for
-  if (pt_mask.bit_size != cipher.block_size) throw std::invalid_argument("Invalid plaintext mask");
-  if (ct_mask.bit_size != cipher.block_size) throw std::invalid_argument("Invalid ciphertext mask");
-  if (key_mask.bit_size != cipher.key_size) throw std::invalid_argument("Invalid key mask");
+  if (pt_mask.bit_size != cipher->block_size) throw std::invalid_argument("Invalid plaintext mask");
+  if (ct_mask.bit_size != cipher->block_size) throw std::invalid_argument("Invalid ciphertext mask");
+  if (key_mask.bit_size != cipher->key_size) throw std::invalid_argument("Invalid key mask");
 
   // Assign
   this->pt_mask = pt_mask;
@@ -92,25 +98,79 @@ attack::attack(const bitstr &pt_mask, const bitstr &ct_mask, const bitstr &key_m
   this->key_mask = key_mask;
   this->bias = bias;
   this->rounds = rounds;
-  this->cipher = cipher;
+}
+
+attack::attack(const bitstr &pt_mask, const bitstr &ct_mask, const bitstr &key_mask, float bias, size_type rounds, const feistel& cipher, uint64_t seed)
+  : attack(pt_mask, ct_mask, key_mask, bias, rounds, feistel_ctx(cipher.share(), cipher.current_key()), seed) {
+}
+
+// Codebook
+void attack::use_codebook(std::shared_ptr<const codebook> book, bool sweep) {
+  if (book) {
+    if (book->block_size != cipher->block_size || book->fingerprint != cipher->fingerprint()) {
+      throw std::invalid_argument("Codebook was built for a different cipher");
+    }
+    if (!ctx.sched || book->key_hash != codebook::hash_key(ctx.sched->key)) {
+      throw std::invalid_argument("Codebook was built under a different key");
+    }
+  }
+  this->book = book;
+  this->sweep = sweep && book;
+}
+
+// Samples
+size_type attack::sample_count(size_type trials, size_type enc_rounds) const {
+  if (!book) return trials;
+  if (book->rounds != enc_rounds) throw std::logic_error("Codebook round count does not match the attack");
+  return sweep ? book->size() : trials;
+}
+
+void attack::samples(size_type beg, size_type count, size_type enc_rounds, std::vector<bitstr>& pts, std::vector<bitstr>& cts) {
+  size_type n = cipher->block_size;
+  pts.resize(count);
+  cts.resize(count);
+
+  // Wide blocks: one at a time
+  if (n > 64) {
+    for (size_type i = 0; i < count; ++i) {
+      pts[i] = rand_bitstr(n, gen);
+      cts[i] = ctx.encrypt(pts[i], enc_rounds);
+    }
+    return;
+  }
+
+  // Packed blocks through the codebook or the (bitsliced) batch path
+  std::vector<uint64_t> pt_words(count), ct_words(count);
+  if (book && sweep) std::iota(pt_words.begin(), pt_words.end(), uint64_t(beg));
+  else gen.fill(pt_words.data(), count, n);
+  if (book) book->encrypt_batch(pt_words.data(), ct_words.data(), count);
+  else ctx.encrypt_batch(pt_words.data(), ct_words.data(), count, enc_rounds);
+  for (size_type i = 0; i < count; ++i) {
+    pts[i] = bitstr(block_type(pt_words[i]), n);
+    cts[i] = bitstr(block_type(ct_words[i]), n);
+  }
 }
 
 // Matsui's 1
 bool attack::matsui1(size_type trials) {
   size_type cnt = 0;
-  for (size_type i = 0; i < trials; ++i) {
-    // Get random plaintext
-    bitstr pt = rand_bitstr(cipher.block_size);
-    // Get encryption
-    bitstr ct = cipher.encrypt(pt, rounds);
-
-    // Modify pt and ct as per initial and final permutations
-    bitstr pt_mod = pt.permute(cipher.ip);
-    bitstr ct_mod = ct.inv_permute(cipher.fp);
-
-    // Get rhs value
-    bool rhs = (pt_mod * pt_mask) ^ (ct_mod * ct_mask);
-    if (rhs) cnt++;
+  trials = sample_count(trials, rounds);
+  std::vector<bitstr> pts, cts;
+  for (size_type beg = 0; beg < trials; beg += SAMPLE_CHUNK) {
+    // Plaintexts and their encryptions, a chunk at a time
+    samples(beg, std::min(SAMPLE_CHUNK, trials - beg), rounds, pts, cts);
+    for (size_type k = 0; k < pts.size(); ++k) {
+      const bitstr& pt = pts[k];
+      const bitstr& ct = cts[k];
+
+      // Modify pt and ct as per initial and final permutations
+      bitstr pt_mod = pt.permute(cipher->ip);
+      bitstr ct_mod = ct.inv_permute(cipher->fp);
+
+      // Get rhs value
+      bool rhs = (pt_mod * pt_mask) ^ (ct_mod * ct_mask);
+      if (rhs) cnt++;
+    }
   }
 
   if ( (cnt-trials/2) * bias >= 0) return true;
@@ -120,11 +180,11 @@ bool attack::matsui1(size_type trials) {
 // Matsui's 2
 std::tuple<std::vector<short_type>, bool> attack::matsui2(size_type trials) {
   // Get left and right halves of the ct_mask
-  bitstr ct_mask_l = ct_mask.extract(0, cipher.block_size / 2);
-  bitstr ct_mask_r = ct_mask.extract(cipher.block_size / 2, cipher.block_size);
+  bitstr ct_mask_l = ct_mask.extract(0, cipher->block_size / 2);
+  bitstr ct_mask_r = ct_mask.extract(cipher->block_size / 2, cipher->block_size);
 
   // Peel back right half of the ciphertext mask
-  bitstr ct_mask_peel = ct_mask_r.inv_permute(cipher.rf_after);
+  bitstr ct_mask_peel = ct_mask_r.inv_permute(cipher->rf_after);
 
   // DEBUG
   std::cout << "ct_mask_peel: " << ct_mask_peel.get_bits() << std::endl;
@@ -135,7 +195,7 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2(size_type trials) {
   size_type start_op = 0;
   size_type net = 0;
 
-  for (auto it = cipher.sboxes.begin(); it != cipher.sboxes.end(); ++it) {
+  for (auto it = cipher->sboxes.begin(); it != cipher->sboxes.end(); ++it) {
     if (ct_mask_peel.value(start_op, start_op + it->output_size) != 0) {
       std::cout << "active sbox at: " << start_ip << " with input size: " << it->input_size << std::endl;
       actives.emplace_back(start_ip, it->input_size);
@@ -150,47 +210,52 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2(size_type trials) {
   for (size_type i = 0; i < (size_type(1)<<net); ++i) baskets.emplace_back(i, 0);
 
   // Iterate through trials
-  for (size_type i = 0; i < trials; ++i) {
-    // Get random plaintext
-    bitstr pt = rand_bitstr(cipher.block_size);
-    // Get encryption
-    bitstr ct = cipher.encrypt(pt, rounds+1);
-    // Modify pt and ct as per initial and final permutations
-    bitstr pt_mod = pt.permute(cipher.ip);
-    bitstr ct_mod = ct.inv_permute(cipher.fp);
-    // Get left and right halves of ct_mod
-    bitstr ct_mod_l = ct_mod.extract(0, cipher.block_size / 2);
-    bitstr ct_mod_r = ct_mod.extract(cipher.block_size / 2, cipher.block_size);
-    // Get temporary rhs value
-    bool rhs = (pt_mod * pt_mask) ^ (ct_mod_l * ct_mask_r) ^ (ct_mod_r * ct_mask_l);
-
-    // Iterate through all candidates
-    for (size_type j = 0; j < baskets.size(); ++j) {
-      // Create empty bistring of round-key size
-      bitstr cand(cipher.rf_before.op_size);
-      // Set bits in appropriate positions
-      size_type shift = net;
-      for (auto it = actives.begin(); it != actives.end(); ++it) {
-        shift -= it->second;
-        cand(it->first, it->first + it->second) = (j >> shift) & ((1 << it->second) - 1);
-      }
-      // Compute round function on right-half of ciphertext
-      bitstr rf_out = cipher.rfunc(ct_mod_r, cand);
-
-      // DEBUG
-      if (i == 0) {
-        std::cout << rf_out.get_bits() << std::endl;
-        std::cout << ct_mask_r.get_bits() << std::endl;
-        std::cout << std::endl;
-      }
-
-      // Get new rhs value
-      bool new_rhs = rhs ^ (rf_out * ct_mask_r);
-      // Update basket appropriately
-      if (new_rhs) {
-        baskets[j].second++;
-      } else {
-        baskets[j].second--;
+  trials = sample_count(trials, rounds + 1);
+  std::vector<bitstr> pts, cts;
+  for (size_type beg = 0; beg < trials; beg += SAMPLE_CHUNK) {
+    // Plaintexts and their encryptions, a chunk at a time
+    samples(beg, std::min(SAMPLE_CHUNK, trials - beg), rounds + 1, pts, cts);
+    for (size_type k = 0; k < pts.size(); ++k) {
+      size_type i = beg + k;
+      const bitstr& pt = pts[k];
+      const bitstr& ct = cts[k];
+      // Modify pt and ct as per initial and final permutations
+      bitstr pt_mod = pt.permute(cipher->ip);
+      bitstr ct_mod = ct.inv_permute(cipher->fp);
+      // Get left and right halves of ct_mod
+      bitstr ct_mod_l = ct_mod.extract(0, cipher->block_size / 2);
+      bitstr ct_mod_r = ct_mod.extract(cipher->block_size / 2, cipher->block_size);
+      // Get temporary rhs value
+      bool rhs = (pt_mod * pt_mask) ^ (ct_mod_l * ct_mask_r) ^ (ct_mod_r * ct_mask_l);
+
+      // Iterate through all candidates
+      for (size_type j = 0; j < baskets.size(); ++j) {
+        // Create empty bistring of round-key size
+        bitstr cand(cipher->rf_before.op_size);
+        // Set bits in appropriate positions
+        size_type shift = net;
+        for (auto it = actives.begin(); it != actives.end(); ++it) {
+          shift -= it->second;
+          cand(it->first, it->first + it->second) = (j >> shift) & ((1 << it->second) - 1);
+        }
+        // Compute round function on right-half of ciphertext
+        bitstr rf_out = cipher->rfunc(ct_mod_r, cand);
+
+        // DEBUG
+        if (i == 0) {
+          std::cout << rf_out.get_bits() << std::endl;
+          std::cout << ct_mask_r.get_bits() << std::endl;
+          std::cout << std::endl;
+        }
+
+        // Get new rhs value
+        bool new_rhs = rhs ^ (rf_out * ct_mask_r);
+        // Update basket appropriately
+        if (new_rhs) {
+          baskets[j].second++;
+        } else {
+          baskets[j].second--;
+        }
       }
     }
   }
@@ -211,10 +276,10 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2(size_type trials) {
   size_type best_basket = baskets[0].first;
 
   // Get round+1 key-schedule
-  auto key_sch = cipher.round_sch[rounds];
+  auto key_sch = cipher->round_sch[rounds];
 
   // Compute and make the candidate key
-  std::vector<short_type> final_cand(cipher.key_size, -1);
+  std::vector<short_type> final_cand(cipher->key_size, -1);
   size_type shift = net;
   for (auto it = actives.begin(); it != actives.end(); ++it) {
     for (size_type j = 0; j < it->second; ++j) {
@@ -228,7 +293,7 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2(size_type trials) {
   std::cout << "Top 10 candidate keys:" << std::endl;
   for (size_type i = 0; i < std::min(size_type(10), baskets.size()); ++i) {
     size_type cand = baskets[i].first;
-    std::vector<short_type> cand_key(cipher.key_size, -1);
+    std::vector<short_type> cand_key(cipher->key_size, -1);
     size_type shift = net;
     for (auto it = actives.begin(); it != actives.end(); ++it) {
       for (size_type j = 0; j < it->second; ++j) {
@@ -250,19 +315,19 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2(size_type trials) {
 // Matsui's 2 (Distilled Version)
 std::tuple<std::vector<short_type>, bool> attack::matsui2_dist(size_type trials) {
   // Get left and right halves of the ct_mask
-  bitstr ct_mask_l = ct_mask.extract(0, cipher.block_size / 2);
-  bitstr ct_mask_r = ct_mask.extract(cipher.block_size / 2, cipher.block_size);
+  bitstr ct_mask_l = ct_mask.extract(0, cipher->block_size / 2);
+  bitstr ct_mask_r = ct_mask.extract(cipher->block_size / 2, cipher->block_size);
 
   // Peel back right half of the ciphertext mask
-  bitstr ct_mask_peel = ct_mask_r.inv_permute(cipher.rf_after);
+  bitstr ct_mask_peel = ct_mask_r.inv_permute(cipher->rf_after);
 
   // Find active sboxes on the bottom-side
   std::vector<std::pair<size_type, size_type>> active;
   size_type start_ip = 0;
   size_type start_op = 0;
   size_type net = 0;
-  bitstr key_bits(cipher.rf_before.op_size);
-  for (auto it = cipher.sboxes.begin(); it != cipher.sboxes.end(); ++it) {
+  bitstr key_bits(cipher->rf_before.op_size);
+  for (auto it = cipher->sboxes.begin(); it != cipher->sboxes.end(); ++it) {
     if (ct_mask_peel.value(start_op, start_op + it->output_size) != 0) {
       active.emplace_back(start_ip, it->input_size);
       net += it->input_size;
@@ -272,7 +337,7 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_dist(size_type trials)
     start_op += it->output_size;
   }
   std::cout << key_bits.get_bits() << std::endl;
-  bitstr ct_bits = key_bits.sinv_permute(cipher.rf_before);
+  bitstr ct_bits = key_bits.sinv_permute(cipher->rf_before);
 
   // Get indices for effective ct bits
   auto eff_ct_bits = ct_bits.one_indices();
@@ -283,29 +348,33 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_dist(size_type trials)
   for (size_type i = 0; i < (size_type(1) << (net)); ++i) table[i] = 0;
 
   // Iterate through trials and update table
-  for (size_type i = 0; i < trials; ++i) {
-    // Generate random plaintext
-    bitstr pt = rand_bitstr(cipher.block_size);
-    // Encrypt plaintext (rounds+2)
-    bitstr ct = cipher.encrypt(pt, rounds + 1);
-    // Modify pt and ct as per initial and final permutations
-    bitstr pt_mod = pt.permute(cipher.ip);
-    bitstr ct_mod = ct.inv_permute(cipher.fp);
-    // Get left and right halves of ct_mod
-    bitstr ct_mod_l = ct_mod.extract(0, cipher.block_size / 2);
-    bitstr ct_mod_r = ct_mod.extract(cipher.block_size / 2, cipher.block_size);
-
-    // Get temporary rhs value 
-    bool rhs = (pt_mod * pt_mask) ^ (ct_mod_l * ct_mask_r) ^ (ct_mod_r * ct_mask_l);
-
-    // Extract effective bits from pt_mod and ct_mod
-    size_type eff_ct_mod = ct_mod_r.get_bits(eff_ct_bits);
-
-    // Increment or decrement table entry based on rhs
-    if (rhs) {
-      table[eff_ct_mod]++;
-    } else {
-      table[eff_ct_mod]--;
+  trials = sample_count(trials, rounds + 1);
+  std::vector<bitstr> pts, cts;
+  for (size_type beg = 0; beg < trials; beg += SAMPLE_CHUNK) {
+    // Plaintexts and their encryptions, a chunk at a time
+    samples(beg, std::min(SAMPLE_CHUNK, trials - beg), rounds + 1, pts, cts);
+    for (size_type k = 0; k < pts.size(); ++k) {
+      const bitstr& pt = pts[k];
+      const bitstr& ct = cts[k];
+      // Modify pt and ct as per initial and final permutations
+      bitstr pt_mod = pt.permute(cipher->ip);
+      bitstr ct_mod = ct.inv_permute(cipher->fp);
+      // Get left and right halves of ct_mod
+      bitstr ct_mod_l = ct_mod.extract(0, cipher->block_size / 2);
+      bitstr ct_mod_r = ct_mod.extract(cipher->block_size / 2, cipher->block_size);
+
+      // Get temporary rhs value 
+      bool rhs = (pt_mod * pt_mask) ^ (ct_mod_l * ct_mask_r) ^ (ct_mod_r * ct_mask_l);
+
+      // Extract effective bits from pt_mod and ct_mod
+      size_type eff_ct_mod = ct_mod_r.get_bits(eff_ct_bits);
+
+      // Increment or decrement table entry based on rhs
+      if (rhs) {
+        table[eff_ct_mod]++;
+      } else {
+        table[eff_ct_mod]--;
+      }
     }
   }
 
@@ -325,7 +394,7 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_dist(size_type trials)
   // Iterate through each candidate key
   for (size_type i = 0; i < (size_type(1) << net); ++i) {
     // Candidate key (bottom)
-    bitstr cand(cipher.rf_before.op_size);
+    bitstr cand(cipher->rf_before.op_size);
     size_type shift = net;
     for (auto it = active.begin(); it != active.end(); ++it) {
       shift -= it->second;
@@ -335,11 +404,11 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_dist(size_type trials)
     // Iterate over each table entry
     for (size_type j = 0; j < (size_type(1) << net); ++j) {
       // Create bitstrings for effective bits and set them
-      bitstr eff(cipher.rf_before.ip_size);
+      bitstr eff(cipher->rf_before.ip_size);
       eff.set_bits(eff_ct_bits, j);
 
       // Compute round function on right-half of ciphertext
-      bitstr rf_out = cipher.rfunc(eff, cand);
+      bitstr rf_out = cipher->rfunc(eff, cand);
 
       // Get temp rhs value
       if (rf_out * ct_mask_r) {
@@ -366,10 +435,10 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_dist(size_type trials)
   size_type best_basket = baskets[0].first;
 
   // Get (round+1)th key-schedule
-  auto key_sch = cipher.round_sch[rounds];
+  auto key_sch = cipher->round_sch[rounds];
 
   // Compute and make the candidate key
-  std::vector<short_type> final_cand(cipher.key_size, -1);
+  std::vector<short_type> final_cand(cipher->key_size, -1);
   size_type shift = net;
   for (auto it = active.begin(); it != active.end(); ++it) {
     for (size_type j = 0; j < it->second; ++j) {
@@ -392,19 +461,19 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_dist(size_type trials)
 // Matsui's 2 (Walsh Version)
 std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials) {
   // Get left and right halves of the ct_mask
-  bitstr ct_mask_l = ct_mask.extract(0, cipher.block_size / 2);
-  bitstr ct_mask_r = ct_mask.extract(cipher.block_size / 2, cipher.block_size);
+  bitstr ct_mask_l = ct_mask.extract(0, cipher->block_size / 2);
+  bitstr ct_mask_r = ct_mask.extract(cipher->block_size / 2, cipher->block_size);
 
   // Peel back right half of the ciphertext mask
-  bitstr ct_mask_peel = ct_mask_r.inv_permute(cipher.rf_after);
+  bitstr ct_mask_peel = ct_mask_r.inv_permute(cipher->rf_after);
 
   // Find active sboxes on the bottom-side
   std::vector<std::pair<size_type, size_type>> active;
   size_type start_ip = 0;
   size_type start_op = 0;
   size_type net = 0;
-  bitstr key_bits(cipher.rf_before.op_size);
-  for (auto it = cipher.sboxes.begin(); it != cipher.sboxes.end(); ++it) {
+  bitstr key_bits(cipher->rf_before.op_size);
+  for (auto it = cipher->sboxes.begin(); it != cipher->sboxes.end(); ++it) {
     if (ct_mask_peel.value(start_op, start_op + it->output_size) != 0) {
       active.emplace_back(start_ip, it->input_size);
       net += it->input_size;
@@ -414,7 +483,7 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
     start_op += it->output_size;
   }
   std::cout << key_bits.get_bits() << std::endl;
-  bitstr ct_bits = key_bits.sinv_permute(cipher.rf_before);
+  bitstr ct_bits = key_bits.sinv_permute(cipher->rf_before);
 
   // Get indices for effective ct bits
   auto eff_ct_bits = ct_bits.one_indices();
@@ -425,29 +494,33 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
   for (size_type i = 0; i < (size_type(1) << (net)); ++i) table[i] = 0;
 
   // Iterate through trials and update table
-  for (size_type i = 0; i < trials; ++i) {
-    // Generate random plaintext
-    bitstr pt = rand_bitstr(cipher.block_size);
-    // Encrypt plaintext (rounds+2)
-    bitstr ct = cipher.encrypt(pt, rounds + 1);
-    // Modify pt and ct as per initial and final permutations
-    bitstr pt_mod = pt.permute(cipher.ip);
-    bitstr ct_mod = ct.inv_permute(cipher.fp);
-    // Get left and right halves of ct_mod
-    bitstr ct_mod_l = ct_mod.extract(0, cipher.block_size / 2);
-    bitstr ct_mod_r = ct_mod.extract(cipher.block_size / 2, cipher.block_size);
-
-    // Get temporary rhs value 
-    bool rhs = (pt_mod * pt_mask) ^ (ct_mod_l * ct_mask_r) ^ (ct_mod_r * ct_mask_l);
-
-    // Extract effective bits from pt_mod and ct_mod
-    size_type eff_ct_mod = ct_mod_r.get_bits(eff_ct_bits);
-
-    // Increment or decrement table entry based on rhs
-    if (rhs) {
-      table[eff_ct_mod]++;
-    } else {
-      table[eff_ct_mod]--;
+  trials = sample_count(trials, rounds + 1);
+  std::vector<bitstr> pts, cts;
+  for (size_type beg = 0; beg < trials; beg += SAMPLE_CHUNK) {
+    // Plaintexts and their encryptions, a chunk at a time
+    samples(beg, std::min(SAMPLE_CHUNK, trials - beg), rounds + 1, pts, cts);
+    for (size_type k = 0; k < pts.size(); ++k) {
+      const bitstr& pt = pts[k];
+      const bitstr& ct = cts[k];
+      // Modify pt and ct as per initial and final permutations
+      bitstr pt_mod = pt.permute(cipher->ip);
+      bitstr ct_mod = ct.inv_permute(cipher->fp);
+      // Get left and right halves of ct_mod
+      bitstr ct_mod_l = ct_mod.extract(0, cipher->block_size / 2);
+      bitstr ct_mod_r = ct_mod.extract(cipher->block_size / 2, cipher->block_size);
+
+      // Get temporary rhs value 
+      bool rhs = (pt_mod * pt_mask) ^ (ct_mod_l * ct_mask_r) ^ (ct_mod_r * ct_mask_l);
+
+      // Extract effective bits from pt_mod and ct_mod
+      size_type eff_ct_mod = ct_mod_r.get_bits(eff_ct_bits);
+
+      // Increment or decrement table entry based on rhs
+      if (rhs) {
+        table[eff_ct_mod]++;
+      } else {
+        table[eff_ct_mod]--;
+      }
     }
   }
 
@@ -462,7 +535,7 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
   bool* func_values = new bool[1 << net];
   for (size_type i = 0; i < (size_type(1) << net); ++i) {
     // Create empty bistring of round-key size
-    bitstr cand(cipher.rf_before.op_size);
+    bitstr cand(cipher->rf_before.op_size);
     // Set bits in appropriate positions
     size_type shift = net;
     for (auto it = active.begin(); it != active.end(); ++it) {
@@ -471,10 +544,10 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
     }
 
     // Create empty bitstring
-    bitstr add_space = bitstr(cipher.rf_before.ip_size);
+    bitstr add_space = bitstr(cipher->rf_before.ip_size);
 
     // Compute round function on right-half of ciphertext
-    bitstr rf_out = cipher.rfunc(add_space, cand);
+    bitstr rf_out = cipher->rfunc(add_space, cand);
     func_values[i] = (rf_out * ct_mask_r);
   }
 
@@ -509,10 +582,10 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
   size_type best_basket = baskets[0].first;
 
   // Get (round+1)th key-schedule
-  auto key_sch = cipher.round_sch[rounds];
+  auto key_sch = cipher->round_sch[rounds];
 
   // Compute and make the candidate key
-  std::vector<short_type> final_cand(cipher.key_size, -1);
+  std::vector<short_type> final_cand(cipher->key_size, -1);
   size_type shift = net;
   for (auto it = active.begin(); it != active.end(); ++it) {
     for (size_type j = 0; j < it->second; ++j) {
@@ -536,22 +609,22 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
 
 /* std::tuple<std::vector<short_type>, bool> attack::matsui2_dist(size_type trials) {
   // Get left and right halves of the pt_mask
-  bitstr pt_mask_l = pt_mask.extract(0, cipher.block_size / 2);
-  bitstr pt_mask_r = pt_mask.extract(cipher.block_size / 2, cipher.block_size);
+  bitstr pt_mask_l = pt_mask.extract(0, cipher->block_size / 2);
+  bitstr pt_mask_r = pt_mask.extract(cipher->block_size / 2, cipher->block_size);
   // Get left and right halves of the ct_mask
-  bitstr ct_mask_l = ct_mask.extract(0, cipher.block_size / 2);
-  bitstr ct_mask_r = ct_mask.extract(cipher.block_size / 2, cipher.block_size);
+  bitstr ct_mask_l = ct_mask.extract(0, cipher->block_size / 2);
+  bitstr ct_mask_r = ct_mask.extract(cipher->block_size / 2, cipher->block_size);
 
   // Peel back left half of the plaintext mask
-  bitstr pt_mask_peel = pt_mask_l.inv_permute(cipher.rf_after);
+  bitstr pt_mask_peel = pt_mask_l.inv_permute(cipher->rf_after);
 
   // Find active sboxes on the top-side
   std::vector<std::pair<size_type, size_type>> active_top;
   size_type start_ip_top = 0;
   size_type start_op_top = 0;
   size_type net_top = 0;
-  bitstr top_key_bits(cipher.rf_before.op_size);
-  for (auto it = cipher.sboxes.begin(); it != cipher.sboxes.end(); ++it) {
+  bitstr top_key_bits(cipher->rf_before.op_size);
+  for (auto it = cipher->sboxes.begin(); it != cipher->sboxes.end(); ++it) {
     if (pt_mask_peel.value(start_op_top, start_op_top + it->output_size) != 0) {
       active_top.emplace_back(start_ip_top, it->input_size);
       net_top += it->input_size;
@@ -561,18 +634,18 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
     start_op_top += it->output_size;
   }
   std::cout << top_key_bits.get_bits() << std::endl;
-  bitstr top_pt_bits = top_key_bits.sinv_permute(cipher.rf_before);
+  bitstr top_pt_bits = top_key_bits.sinv_permute(cipher->rf_before);
 
   // Peel back right half of the ciphertext mask
-  bitstr ct_mask_peel = ct_mask_r.inv_permute(cipher.rf_after);
+  bitstr ct_mask_peel = ct_mask_r.inv_permute(cipher->rf_after);
 
   // Find active sboxes on the bottom-side
   std::vector<std::pair<size_type, size_type>> active_bot;
   size_type start_ip_bot = 0;
   size_type start_op_bot = 0;
   size_type net_bot = 0;
-  bitstr bot_key_bits(cipher.rf_before.op_size);
-  for (auto it = cipher.sboxes.begin(); it != cipher.sboxes.end(); ++it) {
+  bitstr bot_key_bits(cipher->rf_before.op_size);
+  for (auto it = cipher->sboxes.begin(); it != cipher->sboxes.end(); ++it) {
     if (ct_mask_peel.value(start_op_bot, start_op_bot + it->output_size) != 0) {
       active_bot.emplace_back(start_ip_bot, it->input_size);
       net_bot += it->input_size;
@@ -582,7 +655,7 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
     start_op_bot += it->output_size;
   }
   std::cout << bot_key_bits.get_bits() << std::endl;
-  bitstr bot_ct_bits = bot_key_bits.sinv_permute(cipher.rf_before);
+  bitstr bot_ct_bits = bot_key_bits.sinv_permute(cipher->rf_before);
 
   // Get indices for effective pt bits
   auto eff_pt_bits = top_pt_bits.one_indices();
@@ -595,36 +668,39 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
   for (size_type i = 0; i < (size_type(1) << (net_top + net_bot)); ++i) table[i] = 0;
 
   // Iterate through trials and update table
-  for (size_type i = 0; i < trials; ++i) {
-    // Generate random plaintext
-    bitstr pt = rand_bitstr(cipher.block_size);
-    // Encrypt plaintext (rounds+2)
-    bitstr ct = cipher.encrypt(pt, rounds + 2);
-    // Modify pt and ct as per initial and final permutations
-    bitstr pt_mod = pt.permute(cipher.ip);
-    bitstr ct_mod = ct.inv_permute(cipher.fp);
-    // Get left and right halves of pt_mod
-    bitstr pt_mod_l = pt_mod.extract(0, cipher.block_size / 2);
-    bitstr pt_mod_r = pt_mod.extract(cipher.block_size / 2, cipher.block_size);
-    // Get left and right halves of ct_mod
-    bitstr ct_mod_l = ct_mod.extract(0, cipher.block_size / 2);
-    bitstr ct_mod_r = ct_mod.extract(cipher.block_size / 2, cipher.block_size);
-
-    // Get temporary rhs value 
-    bool rhs = (pt_mod_l * pt_mask_r) ^ (pt_mod_r * pt_mask_l) ^ (ct_mod_l * ct_mask_r) ^ (ct_mod_r * ct_mask_l);
-
-    // Extract effective bits from pt_mod and ct_mod
-    size_type eff_pt_mod = pt_mod_r.get_bits(eff_pt_bits);
-    size_type eff_ct_mod = ct_mod_r.get_bits(eff_ct_bits);
-
-    // Determine table index
-    size_type table_index = (eff_pt_mod << net_bot) | eff_ct_mod;
-
-    // Increment or decrement table entry based on rhs
-    if (rhs) {
-      table[table_index]++;
-    } else {
-      table[table_index]--;
+  std::vector<bitstr> pts, cts;
+  for (size_type beg = 0; beg < trials; beg += SAMPLE_CHUNK) {
+    // Plaintexts and their encryptions, a chunk at a time
+    samples(beg, std::min(SAMPLE_CHUNK, trials - beg), rounds + 2, pts, cts);
+    for (size_type k = 0; k < pts.size(); ++k) {
+      const bitstr& pt = pts[k];
+      const bitstr& ct = cts[k];
+      // Modify pt and ct as per initial and final permutations
+      bitstr pt_mod = pt.permute(cipher->ip);
+      bitstr ct_mod = ct.inv_permute(cipher->fp);
+      // Get left and right halves of pt_mod
+      bitstr pt_mod_l = pt_mod.extract(0, cipher->block_size / 2);
+      bitstr pt_mod_r = pt_mod.extract(cipher->block_size / 2, cipher->block_size);
+      // Get left and right halves of ct_mod
+      bitstr ct_mod_l = ct_mod.extract(0, cipher->block_size / 2);
+      bitstr ct_mod_r = ct_mod.extract(cipher->block_size / 2, cipher->block_size);
+
+      // Get temporary rhs value 
+      bool rhs = (pt_mod_l * pt_mask_r) ^ (pt_mod_r * pt_mask_l) ^ (ct_mod_l * ct_mask_r) ^ (ct_mod_r * ct_mask_l);
+
+      // Extract effective bits from pt_mod and ct_mod
+      size_type eff_pt_mod = pt_mod_r.get_bits(eff_pt_bits);
+      size_type eff_ct_mod = ct_mod_r.get_bits(eff_ct_bits);
+
+      // Determine table index
+      size_type table_index = (eff_pt_mod << net_bot) | eff_ct_mod;
+
+      // Increment or decrement table entry based on rhs
+      if (rhs) {
+        table[table_index]++;
+      } else {
+        table[table_index]--;
+      }
     }
   }
 
@@ -645,7 +721,7 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
   for (size_type i = 0; i < (size_type(1) << (net_top + net_bot)); ++i) {
     // Candidate key (top)
     size_type top_value = i >> net_bot;
-    bitstr cand_top(cipher.rf_before.op_size);
+    bitstr cand_top(cipher->rf_before.op_size);
     size_type shift_top = net_top;
     for (auto it = active_top.begin(); it != active_top.end(); ++it) {
       shift_top -= it->second;
@@ -654,7 +730,7 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
    
     // Candidate key (bottom)
     size_type bot_value = i & ((1 << net_bot) - 1);
-    bitstr cand_bot(cipher.rf_before.op_size);
+    bitstr cand_bot(cipher->rf_before.op_size);
     size_type shift_bot = net_bot;
     for (auto it = active_bot.begin(); it != active_bot.end(); ++it) {
       shift_bot -= it->second;
@@ -668,16 +744,16 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
       size_type eff_ct_mod = j & ((1 << net_bot) - 1);
 
       // Create bitstrings for effective bits and set them
-      bitstr eff_top(cipher.rf_before.ip_size);
-      bitstr eff_bot(cipher.rf_before.ip_size);
+      bitstr eff_top(cipher->rf_before.ip_size);
+      bitstr eff_bot(cipher->rf_before.ip_size);
       eff_top.set_bits(eff_pt_bits, eff_pt_mod);
       eff_bot.set_bits(eff_ct_bits, eff_ct_mod);
 
       // Compute round function on right-half of plaintext
-      bitstr rf_out_top = cipher.rfunc(eff_top, cand_top);
+      bitstr rf_out_top = cipher->rfunc(eff_top, cand_top);
 
       // Compute round function on right-half of ciphertext
-      bitstr rf_out_bot = cipher.rfunc(eff_bot, cand_bot);
+      bitstr rf_out_bot = cipher->rfunc(eff_bot, cand_bot);
 
       // Get temp rhs value
       if ((rf_out_top * pt_mask_r) ^ (rf_out_bot * ct_mask_r)) {
@@ -706,11 +782,11 @@ std::tuple<std::vector<short_type>, bool> attack::matsui2_walsh(size_type trials
   size_type best_basket_bot = best_basket & ((1 << net_bot) - 1);
 
   // Get 1st and (rounds+2)th key-schedule
-  auto key_sch_top = cipher.round_sch[0];
-  auto key_sch_bot = cipher.round_sch[rounds + 1];
+  auto key_sch_top = cipher->round_sch[0];
+  auto key_sch_bot = cipher->round_sch[rounds + 1];
 
   // Compute and make the candidate key
-  std::vector<short_type> final_cand(cipher.key_size, -1);
+  std::vector<short_type> final_cand(cipher->key_size, -1);
   // Top-part
   size_type shift_top = net_top;
   for (auto it = active_top.begin(); it != active_top.end(); ++it) {
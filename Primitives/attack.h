@@ -9,6 +9,8 @@
 #include "feistel.h"
 #include "sbox.h"
 #include "bitstr.h"
+#include "prng.h"
+#include "codebook.h"
 
 // Mains
 #include <iostream>
@@ -18,9 +20,12 @@
 #include <cmath>
 #include <string>
 #include <complex>
+#include <memory>
+#include <numeric>
+#include <algorithm>
 
 // Helpers
-bitstr rand_bitstr(size_type size);
+bitstr rand_bitstr(size_type size, prng& gen);
 std::string get_tern_bits(std::vector<short_type> arr);
 
 // Recursive Walsh Transform
@@ -39,17 +44,35 @@ class attack
     // bitstr fin_key_mask;
     float bias;
     size_type rounds;
-    feistel cipher;
+    std::shared_ptr<const feistel> cipher;   // shared description
+    feistel_ctx ctx;                          // cipher under the key being attacked
+    prng gen;           // plaintext source (fixed by the seed)
+    std::shared_ptr<const codebook> book;    // optional: ciphertexts by lookup
+    bool sweep = false;                       // with a codebook: every plaintext once
+
+    // Constructors (the second copies the cipher once and uses its assigned key)
+    attack(const bitstr &pt_mask, const bitstr &ct_mask, const bitstr &key_mask, float bias, size_type rounds, const feistel_ctx& ctx, uint64_t seed = 0);
+    attack(const bitstr &pt_mask, const bitstr &ct_mask, const bitstr &key_mask, float bias, size_type rounds, const feistel& cipher, uint64_t seed = 0);
+
+    // Answer queries from a full codebook instead of encrypting. Its round count
+    // must be the one a method encrypts with (rounds for matsui1, rounds + 1 for
+    // the matsui2 family), and it must have been built under the attacked key.
+    // With sweep, trials is ignored and every plaintext is used exactly once.
+    void use_codebook(std::shared_ptr<const codebook> book, bool sweep = false);
 
-    // Constructor
-    attack(const bitstr &pt_mask, const bitstr &ct_mask, const bitstr &key_mask, float bias, size_type rounds, feistel cipher);
-        
     // Standard Matsui's
     bool matsui1(size_type trials);
     std::tuple<std::vector<short_type>, bool> matsui2(size_type trials);
     std::tuple<std::vector<short_type>, bool> matsui2_dist(size_type trials);
     std::tuple<std::vector<short_type>, bool> matsui2_walsh(size_type trials);
 
+  private:
+    // Plaintext/ciphertext pairs: the number of trials to run, and trials
+    // beg .. beg + count - 1 (random plaintexts from prng::fill, encrypted
+    // with the batch API; blocks wider than 64 bits one at a time)
+    static const size_type SAMPLE_CHUNK = size_type(1) << 16;
+    size_type sample_count(size_type trials, size_type enc_rounds) const;
+    void samples(size_type beg, size_type count, size_type enc_rounds, std::vector<bitstr>& pts, std::vector<bitstr>& cts);
 };
 
 #endif
@@ -43,6 +43,11 @@ bitstr::bitstr(const bitstr &other) : bit_size(other.bit_size) {
   }
 }
 
+bitstr::bitstr(bitstr &&other) noexcept : bit_size(other.bit_size), blocks(other.blocks) {
+  other.bit_size = 0;
+  other.blocks = nullptr;
+}
+
 bitstr::bitstr(block_type value, size_type size) {
   // Reverse
   block_type temp = reverse_bits(value, size);
@@ -51,6 +56,34 @@ bitstr::bitstr(block_type value, size_type size) {
   blocks[0] = temp;
 }
 
+// Destructor
+bitstr::~bitstr() {
+  delete[] blocks;
+}
+
+// Assignment
+bitstr& bitstr::operator=(const bitstr &other) {
+  if (this == &other) return *this;
+  size_type block_count = (other.bit_size + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+  if (block_count != (bit_size + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK || blocks == nullptr) {
+    delete[] blocks;
+    blocks = new block_type[std::max<size_type>(block_count, 1)];
+  }
+  bit_size = other.bit_size;
+  std::copy(other.blocks, other.blocks + block_count, blocks);
+  return *this;
+}
+
+bitstr& bitstr::operator=(bitstr &&other) noexcept {
+  if (this == &other) return *this;
+  delete[] blocks;
+  bit_size = other.bit_size;
+  blocks = other.blocks;
+  other.bit_size = 0;
+  other.blocks = nullptr;
+  return *this;
+}
+
 // Bit-Access Proxy Implementations
 bitstr::bit_proxy bitstr::operator[](unsigned index){
   // Index within bounds
@@ -294,16 +327,13 @@ void bitstr::operator+=(const bitstr other)
 
   // Copy new blocks
   size_type offset = (bit_size - other.bit_size) % BITS_PER_BLOCK;
-  block_type *start_block = new_blocks + (bit_size - other.bit_size + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK - 1;
-  if (offset == 0) start_block += 1; // Ensure we start at the next block if no offset
-
+  size_type base = (bit_size - other.bit_size) / BITS_PER_BLOCK;
   for (size_type i = 0; i < (other.bit_size + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK; ++i) {
-    // Left shift the bits of the new block    
-    *start_block |= (other.blocks[i] << offset);
+    // Left shift the bits of the new block
+    new_blocks[base + i] |= (other.blocks[i] << offset);
     // If offset != 0, assign remaining bits to the next block
-    if (offset > 0) {
-      start_block += 1;
-      *start_block |= (other.blocks[i] >> (BITS_PER_BLOCK - offset));
+    if (offset > 0 && base + i + 1 < new_block_count) {
+      new_blocks[base + i + 1] |= (other.blocks[i] >> (BITS_PER_BLOCK - offset));
     }
   }
 
@@ -347,7 +377,7 @@ void bitstr::operator^=(const bitstr other)
   return;
 }
 
-// Dot Product
+// Dot Product (parity of the AND, not "any common bit")
 bool bitstr::operator*(const bitstr other) const
 {
   if (bit_size != other.bit_size) {
@@ -355,7 +385,7 @@ bool bitstr::operator*(const bitstr other) const
   }
   bool result = false;
   for (size_type i = 0; i < (bit_size + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK; ++i) {
-    result ^= (blocks[i] & other.blocks[i]);
+    result ^= __builtin_parityll(blocks[i] & other.blocks[i]);
   }
   return result;
 }
@@ -401,7 +431,64 @@ void bitstr::operator~()
 }
 
 // Substitution
-bitstr bitstr::substitute(std::vector<size_type> sub_arr, size_type sub_size) const {
+// Word of bits [64 w, 64 w + 64), with bits past the end read as zero
+static block_type word_at(const bitstr& str, long w)
+{
+  const size_type W = bitstr::BITS_PER_BLOCK;
+  size_type count = (str.bit_size + W - 1) / W;
+  if (w < 0 || size_type(w) >= count) return 0;
+  block_type value = str.blocks[w];
+  size_type tail = str.bit_size % W;
+  if (size_type(w) == count - 1 && tail != 0) value &= (block_type(1) << tail) - 1;
+  return value;
+}
+
+// Shifts and Rotations
+bitstr bitstr::operator<<(size_type k) const {
+  bitstr result(bit_size);
+  size_type count = (bit_size + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+  long q = long(k / BITS_PER_BLOCK);
+  size_type r = k % BITS_PER_BLOCK;
+  for (size_type w = 0; w < count; ++w) {
+    block_type lo = word_at(*this, long(w) + q);
+    block_type hi = word_at(*this, long(w) + q + 1);
+    result.blocks[w] = (r == 0) ? lo : ((lo >> r) | (hi << (BITS_PER_BLOCK - r)));
+  }
+  size_type tail = bit_size % BITS_PER_BLOCK;
+  if (tail != 0) result.blocks[count - 1] &= (block_type(1) << tail) - 1;
+  return result;
+}
+
+bitstr bitstr::operator>>(size_type k) const {
+  bitstr result(bit_size);
+  size_type count = (bit_size + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+  long q = long(k / BITS_PER_BLOCK);
+  size_type r = k % BITS_PER_BLOCK;
+  for (size_type w = 0; w < count; ++w) {
+    block_type hi = word_at(*this, long(w) - q);
+    block_type lo = word_at(*this, long(w) - q - 1);
+    result.blocks[w] = (r == 0) ? hi : ((hi << r) | (lo >> (BITS_PER_BLOCK - r)));
+  }
+  size_type tail = bit_size % BITS_PER_BLOCK;
+  if (tail != 0) result.blocks[count - 1] &= (block_type(1) << tail) - 1;
+  return result;
+}
+
+bitstr bitstr::rotl(size_type k) const {
+  if (bit_size == 0) return *this;
+  k %= bit_size;
+  if (k == 0) return (*this) << 0;
+  bitstr result = (*this) << k;
+  result |= (*this) >> (bit_size - k);
+  return result;
+}
+
+bitstr bitstr::rotr(size_type k) const {
+  if (bit_size == 0) return *this;
+  return rotl(bit_size - k % bit_size);
+}
+
+bitstr bitstr::substitute(const std::vector<size_type>& sub_arr, size_type sub_size) const {
   // Create new bitstr with size of sub_size
   bitstr result(sub_size);
 
@@ -415,7 +502,7 @@ bitstr bitstr::substitute(std::vector<size_type> sub_arr, size_type sub_size) co
   return result;
 }
 
-bitstr bitstr::permute(perm stuff) const {
+bitstr bitstr::permute(const perm& stuff) const {
   // Check if permutation is valid
   if (stuff.ip_size != bit_size) {
     throw std::invalid_argument("Permutation input size does not match bitstr size");
@@ -424,12 +511,16 @@ bitstr bitstr::permute(perm stuff) const {
   // Create new bitstr with output_size
   bitstr result(stuff.op_size);
 
-  // Iterate and substitute
-  for (size_type i = 0; i < stuff.op_size; ++i) result[i] = (*this)[stuff.main_table[i]];
+  // Iterate and substitute (word access, no proxies)
+  for (size_type i = 0; i < stuff.op_size; ++i) {
+    size_type j = stuff.main_table[i];
+    block_type bit = (blocks[j / BITS_PER_BLOCK] >> (j % BITS_PER_BLOCK)) & 1;
+    result.blocks[i / BITS_PER_BLOCK] |= bit << (i % BITS_PER_BLOCK);
+  }
   return result;
 }
 
-bitstr bitstr::inv_permute(perm stuff) const {
+bitstr bitstr::inv_permute(const perm& stuff) const {
   // Check if permutation is valid
   if (stuff.op_size != bit_size) {
     throw std::invalid_argument("Permutation output size does not match bitstr size");
@@ -454,7 +545,7 @@ bitstr bitstr::inv_permute(perm stuff) const {
   else return result; // Return empty bitstr
 }
 
-bitstr bitstr::sinv_permute(perm stuff) const {
+bitstr bitstr::sinv_permute(const perm& stuff) const {
   // Check if permutation is valid
   if (stuff.op_size != bit_size) {
     throw std::invalid_argument("Permutation output size does not match bitstr size");
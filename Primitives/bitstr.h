@@ -33,8 +33,16 @@ class bitstr {
     bitstr(size_type size);
     bitstr(block_type *data, size_type size);
     bitstr(const bitstr &other);
+    bitstr(bitstr &&other) noexcept;
     bitstr(block_type value, size_type size);
 
+    // Destructor
+    ~bitstr();
+
+    // Assignment
+    bitstr& operator=(const bitstr &other);
+    bitstr& operator=(bitstr &&other) noexcept;
+
     // Proxy Object for bit access
     class bit_proxy {
       private:
@@ -112,16 +120,22 @@ class bitstr {
     void operator^=(const bitstr other);
     void operator&=(const bitstr other);
     void operator~();
-    bool operator*(const bitstr other) const;   // Dot product
+    bool operator*(const bitstr other) const;   // Dot product over GF(2): parity of the common bits
     bool operator==(const bitstr other) const;
     bool operator!=(const bitstr other) const;
     bitstr operator^(const bitstr other) const;
 
+    // Shifts and Rotations (towards index 0, like the integer value)
+    bitstr operator<<(size_type k) const;       // out[i] = in[i + k], zeros shifted in
+    bitstr operator>>(size_type k) const;       // out[i] = in[i - k], zeros shifted in
+    bitstr rotl(size_type k) const;             // out[i] = in[(i + k) % size]
+    bitstr rotr(size_type k) const;             // out[i] = in[(i - k) % size]
+
     // Substitution
-    bitstr substitute(std::vector<size_type> sub_arr, size_type sub_size) const;
-    bitstr permute(perm stuff) const;
-    bitstr inv_permute(perm stuff) const;
-    bitstr sinv_permute(perm stuff) const;
+    bitstr substitute(const std::vector<size_type>& sub_arr, size_type sub_size) const;
+    bitstr permute(const perm& stuff) const;
+    bitstr inv_permute(const perm& stuff) const;
+    bitstr sinv_permute(const perm& stuff) const;
 
     // One-Indices
     std::vector<size_type> one_indices() const;
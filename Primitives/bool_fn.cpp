@@ -1,50 +1,23 @@
 // Code for boolean function class & helpers
 
 #include "bool_fn.h"
-
-// Mobius matrix entries
-uint get_mobius(uint r, uint c, uint n)
-{
-    // Base matrix:
-    // | 1 1 |
-    // | 0 1 |
-
-    // Higher matrices are determined by tensoring with self.
-    if ((r < 0) || (c < 0) || (r > (1 << n)) || (c > (1 << n)))
-    {
-        throw std::out_of_range("r or c out of range");
-    }
-
-    uint mobius = 1;
-    for (uint i = 0; i < n; i++)
-    {
-        if ((r & (uint(1) << i)) && !(c & (uint(1) << i)))
-        {
-            mobius = 0;
-            break;
-        }
-    }
-    return mobius;
-}
-
-
+#include "sbox_cache.h"
 
 // Constructors
 bool_fn::bool_fn(uint in, uint out, std::vector<uint> values) {
   // Assert that the number of values matches the output size
-  if (values.size() != (1 << in)) {
+  if (values.size() != (size_type(1) << in)) {
     throw std::invalid_argument("Number of values does not match input size");
   }
   this->in = in;
   this->out = out;
-  for (uint i = 0; i < (1 << in); i++) {
-    if (values[i] >= (1 << out)) {
+  for (uint i = 0; i < (uint(1) << in); i++) {
+    if (values[i] >= (uint(1) << out)) {
       throw std::invalid_argument("Output value exceeds output size");
     }
   }
-  this->values = values;
-  get_cycles(); // Automatically compute cycles on construction
-  get_polynomial(); // Automatically compute polynomial representation on construction
+  this->values = std::move(values);
+  clear_cache();
 }
 
 // Constructor from SBox
@@ -52,11 +25,34 @@ bool_fn::bool_fn(const sbox& mybox) {
   this->in = mybox.input_size;
   this->out = mybox.output_size;
   this->values.resize(1 << in);
-  for (uint i = 0; i < (1 << in); i++) {
+  for (uint i = 0; i < (uint(1) << in); i++) {
     this->values[i] = mybox[i];
   }
-  get_cycles(); // Automatically compute cycles on construction
-  get_polynomial(); // Automatically compute polynomial representation on construction
+  clear_cache();
+}
+
+// Constructor from a Feistel cipher (codebook of the first rounds rounds)
+bool_fn::bool_fn(const feistel& cipher, size_type rounds) {
+  if (cipher.block_size >= 32) {
+    throw std::invalid_argument("Block size too large for a value table");
+  }
+  if (rounds > cipher.max_rounds) {
+    throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+  }
+  this->in = cipher.block_size;
+  this->out = cipher.block_size;
+  size_type size = size_type(1) << in;
+  this->values.resize(size);
+
+  // Encrypt in slabs through the batch API
+  size_type slab = std::min(size, size_type(1) << 20);
+  std::vector<uint64_t> buffer(slab);
+  for (size_type beg = 0; beg < size; beg += slab) {
+    for (size_type i = 0; i < slab; ++i) buffer[i] = beg + i;
+    cipher.encrypt_batch(buffer.data(), buffer.data(), slab, rounds);
+    std::copy(buffer.begin(), buffer.end(), values.begin() + beg);
+  }
+  clear_cache();
 }
 
 // Copy constructor
@@ -64,9 +60,18 @@ bool_fn::bool_fn(const bool_fn& other) {
   this->in = other.in;
   this->out = other.out;
   this->values = other.values;
+  this->balanced_invariants = other.balanced_invariants;
+  this->have_bij = other.have_bij;
+  this->have_cycles = other.have_cycles;
+  this->have_leads = other.have_leads;
+  this->have_poly = other.have_poly;
+  this->have_walsh = other.have_walsh;
   this->is_bij = other.is_bij;
-  if (is_bij) this->cycles = other.cycles;
-  if (out == 1) this->poly = other.poly;
+  this->cycles = other.cycles;
+  this->cycle_leads = other.cycle_leads;
+  this->cycle_lens = other.cycle_lens;
+  this->poly = other.poly;
+  this->walsh = other.walsh;
 }
 
 // Destructor (empty)
@@ -74,31 +79,48 @@ bool_fn::~bool_fn() {
   // No dynamic memory to free, so nothing to do here
 }
 
+// Reset caches
+void bool_fn::clear_cache() {
+  have_bij = false;
+  have_cycles = false;
+  have_leads = false;
+  have_poly = false;
+  have_walsh = false;
+  is_bij = false;
+  cycles.clear();
+  cycle_leads.clear();
+  cycle_lens.clear();
+  poly.clear();
+  walsh.clear();
+}
+
 // Getter
 uint bool_fn::operator[](uint input) const {
-  if (input >= (1 << in)) {
+  if (input >= (uint(1) << in)) {
     throw std::out_of_range("Input value exceeds input size");
   }
   return values[input];
 }
 
-// Get polynomial representation
-void bool_fn::get_polynomial() {
+// Get polynomial representation (fast Mobius transform)
+const std::vector<uint>& bool_fn::get_polynomial() const {
+  if (have_poly) return poly;
+
   // Do only if out == 1
   if (out != 1) {
-    std::cerr << "Polynomial representation is only available for single-output functions." << std::endl;
-    return;
+    throw std::logic_error("Polynomial representation is only available for single-output functions.");
   }
 
-  // Initialize polynomial coefficients
-  uint size = 1 << in;
-  poly.resize(1 << in, 0);
-  for (uint i = 0; i < size; i++) {
-    poly[i] = 0;
-    for (uint j = 0; j < size; j++) {
-      poly[i] ^= (values[j] & get_mobius(j, i, in));
+  // In-place butterflies: poly[i | bit] ^= poly[i]
+  size_type size = size_type(1) << in;
+  poly = values;
+  for (size_type bit = 1; bit < size; bit <<= 1) {
+    for (size_type i = 0; i < size; i++) {
+      if (i & bit) poly[i] ^= poly[i ^ bit];
     }
   }
+  have_poly = true;
+  return poly;
 }
 
 // Print polynomial representation
@@ -109,6 +131,7 @@ void bool_fn::print_polynomial() const {
     return;
   }
 
+  const std::vector<uint>& poly = get_polynomial();
   for (uint i = 0; i < (uint(1)<<in); i++)
     {
         if (poly[i] == 0)
@@ -127,124 +150,450 @@ void bool_fn::print_polynomial() const {
 }
 
 // Check if bijective
-void bool_fn::is_bijective() {
+bool bool_fn::is_bijective() const {
+  if (have_bij) return is_bij;
+  have_bij = true;
+
   // Check if in == out
   if (in != out) {
     is_bij = false;
-    return;
+    return is_bij;
   }
 
   // Check if all output values are unique (use bitstrings)
-  bitstr output_seen(1 << out);
-  for (uint i = 0; i < (1 << in); i++) {
+  bitstr output_seen(size_type(1) << out);
+  is_bij = true;
+  for (uint i = 0; i < (uint(1) << in); i++) {
     uint output_value = values[i];
     if (output_seen[output_value]) {
       // If we have seen this output value before, it is not bijective
       is_bij = false;
-      return;
+      break;
     }
     else {
       // Mark this output value as seen
       output_seen[output_value] = 1;
     }
   }
+  return is_bij;
+}
 
-  // Otherwise, it is bijective
-  is_bij = true;
+// Getting all cycles (empty if the function is not bijective)
+const std::vector<std::vector<uint>>& bool_fn::get_cycles() const {
+  if (have_cycles) return cycles;
+  have_cycles = true;
+
+  // Walk each cycle from its leader
+  const auto& leads = get_cycle_leaders();
+  cycles.assign(leads.size(), std::vector<uint>());
+  for (size_type i = 0; i < leads.size(); i++) {
+    cycles[i].reserve(cycle_lens[i]);
+    uint current = leads[i];
+    do {
+      cycles[i].push_back(current);
+      current = values[current];
+    } while (current != leads[i]);
+  }
+
+  // End
+  return cycles;
 }
 
-// Getting all cycles
-void bool_fn::get_cycles() {
-  // Check if bijective first
-  is_bijective();
-  if (!is_bij) {
-    std::cerr << "Function is not bijective, cannot get cycles." << std::endl;
-    return;
+// Cycle leaders (empty if the function is not bijective)
+// Threads scan contiguous ranges and walk forward from every unclaimed
+// element, claiming each element in a shared bitmap. A walk that returns to
+// its start is a whole cycle; one that runs into a claimed element has reached
+// the start of another walk, and these pieces are chained together afterwards.
+const std::vector<uint>& bool_fn::get_cycle_leaders() const {
+  if (have_leads) return cycle_leads;
+  have_leads = true;
+  cycle_leads.clear();
+  cycle_lens.clear();
+  if (!is_bijective()) return cycle_leads;
+
+  const size_type W = sizeof(block_type) * 8;
+  size_type size = size_type(1) << in;
+  std::vector<std::atomic<block_type>> claimed((size + W - 1) / W);
+  auto claim = [&](uint y) {
+    block_type bit = block_type(1) << (y % W);
+    return (claimed[y / W].fetch_or(bit, std::memory_order_relaxed) & bit) == 0;
+  };
+
+  // Walk pieces that ran into another walk
+  struct piece
+  {
+    uint start;
+    uint stop;      // start of the piece that follows
+    uint low;       // smallest element seen
+    size_type len;
+  };
+  std::vector<std::pair<uint, size_type>> found;   // (leader, length)
+  std::vector<piece> pieces;
+  std::mutex found_lock;
+
+  parallel_for(size, 1 << 12, [&](size_type beg, size_type end) {
+    std::vector<std::pair<uint, size_type>> my_found;
+    std::vector<piece> my_pieces;
+    for (size_type x = beg; x < end; ++x) {
+      if (!claim(uint(x))) continue;
+      uint y = uint(x);
+      uint low = y;
+      size_type len = 1;
+      while (true) {
+        uint z = values[y];
+        if (z == x) {
+          my_found.push_back({low, len});
+          break;
+        }
+        if (!claim(z)) {
+          my_pieces.push_back({uint(x), z, low, len});
+          break;
+        }
+        y = z;
+        low = std::min(low, y);
+        ++len;
+      }
+    }
+    std::lock_guard<std::mutex> guard(found_lock);
+    found.insert(found.end(), my_found.begin(), my_found.end());
+    pieces.insert(pieces.end(), my_pieces.begin(), my_pieces.end());
+  });
+
+  // Chain the pieces into cycles
+  std::sort(pieces.begin(), pieces.end(), [](const piece& a, const piece& b) {
+    return a.start < b.start;
+  });
+  std::vector<bool> used(pieces.size(), false);
+  for (size_type i = 0; i < pieces.size(); ++i) {
+    if (used[i]) continue;
+    uint low = pieces[i].low;
+    size_type len = 0;
+    size_type k = i;
+    do {
+      used[k] = true;
+      low = std::min(low, pieces[k].low);
+      len += pieces[k].len;
+      piece key{pieces[k].stop, 0, 0, 0};
+      k = std::lower_bound(pieces.begin(), pieces.end(), key, [](const piece& a, const piece& b) {
+        return a.start < b.start;
+      }) - pieces.begin();
+    } while (k != i);
+    found.push_back({low, len});
   }
 
-  // Clear all existing cycles
-  cycles.clear();
+  // Ascending leaders, i.e. the order of a sequential scan
+  std::sort(found.begin(), found.end());
+  cycle_leads.reserve(found.size());
+  cycle_lens.reserve(found.size());
+  for (const auto& f : found) {
+    cycle_leads.push_back(f.first);
+    cycle_lens.push_back(f.second);
+  }
+  return cycle_leads;
+}
+
+// Cycle lengths (same order as the leaders)
+const std::vector<size_type>& bool_fn::get_cycle_lengths() const {
+  get_cycle_leaders();
+  return cycle_lens;
+}
+
+// Walsh spectrum of every component function b.F (fast Walsh-Hadamard transform per output mask)
+const std::vector<int>& bool_fn::get_walsh() const {
+  if (have_walsh) return walsh;
+
+  size_type size = size_type(1) << in;
+  size_type masks = size_type(1) << out;
+  walsh.assign(size * masks, 0);
+  parallel_for(masks, 16, [&](size_type beg, size_type end) {
+    for (size_type b = beg; b < end; ++b) {
+      int* row = walsh.data() + b * size;
+      for (size_type x = 0; x < size; ++x) {
+        row[x] = (__builtin_popcountl(b & values[x]) & 1) ? -1 : 1;
+      }
+      for (size_type h = 1; h < size; h <<= 1) {
+        for (size_type i = 0; i < size; i += 2 * h) {
+          for (size_type j = i; j < i + h; ++j) {
+            int u = row[j];
+            int v = row[j + h];
+            row[j] = u + v;
+            row[j + h] = u - v;
+          }
+        }
+      }
+    }
+  });
+  have_walsh = true;
+  return walsh;
+}
 
-  // Create a bitstr to track visited inputs
-  bitstr visited(1 << in);
-  for (uint i = 0; i < (1 << in); i++) {
-    if (visited[i]) continue; // Skip already visited inputs
+// Helpers for the subset-sum tables
+// Bits per word of the reachability tables
+static const size_type REACH_BITS = sizeof(block_type) * 8;
 
-    // Start a new cycle
-    std::vector<uint> cycle;
-    uint current = i;
+// dst |= (src << shift) for every shift in {len, 2*len, ..., mult*len}, run in parallel over words
+static void shift_or(std::vector<block_type>& dst, const std::vector<block_type>& src, size_type len, size_type mult)
+{
+  parallel_for(dst.size(), 1 << 14, [&](size_type beg, size_type end) {
+    for (size_type k = 1; k <= mult; ++k) {
+      size_type word_shift = (k * len) / REACH_BITS;
+      size_type bit_shift = (k * len) % REACH_BITS;
+      for (size_type w = std::max(beg, word_shift); w < end; ++w) {
+        block_type val = src[w - word_shift] << bit_shift;
+        if (bit_shift && w > word_shift) val |= src[w - word_shift - 1] >> (REACH_BITS - bit_shift);
+        dst[w] |= val;
+      }
+    }
+  });
+}
 
-    do {
-      cycle.push_back(current);
-      visited[current] = 1;
-      current = values[current]; // Move to the next input in the cycle
-    } while (current != i); // Stop when we return to the start
+// Saturating arithmetic for counts
+static size_type sat_add(size_type a, size_type b)
+{
+  return (a > SIZE_MAX - b) ? SIZE_MAX : a + b;
+}
+
+static size_type sat_mul(size_type a, size_type b)
+{
+  if (a == 0 || b == 0) return 0;
+  return (a > SIZE_MAX / b) ? SIZE_MAX : a * b;
+}
+
+// Stream constructor: group cycles by length and build the reachability tables
+bool_fn::inv_stream::inv_stream(const std::vector<size_type>& lengths, size_type target)
+{
+  this->num_cycles = lengths.size();
+  this->target = target;
+
+  // Group cycles of equal length (longest first)
+  std::vector<size_type> order(lengths.size());
+  for (size_type i = 0; i < order.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_type a, size_type b) {
+    return lengths[a] > lengths[b];
+  });
+  for (auto idx : order) {
+    if (groups.empty() || groups.back().len != lengths[idx]) groups.push_back({lengths[idx], {}});
+    groups.back().members.push_back(idx);
+  }
 
-    // Add the completed cycle to the list
-    cycles.push_back(cycle);
+  // Reachable sums, built from the last group backwards
+  size_type words = target / REACH_BITS + 1;
+  block_type tail = (target % REACH_BITS == REACH_BITS - 1) ? ~block_type(0)
+                    : ((block_type(1) << (target % REACH_BITS + 1)) - 1);
+  reach.assign(groups.size() + 1, std::vector<block_type>());
+  reach[groups.size()].assign(words, 0);
+  reach[groups.size()][0] = 1;
+  for (size_type g = groups.size(); g > 0; --g) {
+    reach[g-1] = reach[g];
+    size_type mult = std::min(groups[g-1].members.size(), target / groups[g-1].len);
+    shift_or(reach[g-1], reach[g], groups[g-1].len, mult);
+    reach[g-1][words-1] &= tail;
   }
 
-  // End
-  return;
+  // Enumeration state
+  rem.assign(groups.size() + 1, 0);
+  pick.assign(groups.size(), std::vector<size_type>());
+  started = false;
+  done = false;
+}
+
+// Check whether groups g.. can sum up to sum
+bool bool_fn::inv_stream::reachable(size_type g, size_type sum) const
+{
+  if (sum > target) return false;
+  return (reach[g][sum / REACH_BITS] >> (sum % REACH_BITS)) & 1;
+}
+
+// Pick the smallest feasible number of members (at least from) for group g
+bool bool_fn::inv_stream::first_pick(size_type g, size_type from)
+{
+  size_type len = groups[g].len;
+  size_type lim = groups[g].members.size();
+  for (size_type k = from; k <= lim && k * len <= rem[g]; ++k) {
+    if (reachable(g + 1, rem[g] - k * len)) {
+      pick[g].resize(k);
+      for (size_type i = 0; i < k; ++i) pick[g][i] = i;
+      rem[g+1] = rem[g] - k * len;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Fill groups g.. with their first feasible picks (always succeeds by construction)
+void bool_fn::inv_stream::descend(size_type g)
+{
+  for (; g < groups.size(); ++g) first_pick(g, 0);
+}
+
+// Step to the next invariant
+bool bool_fn::inv_stream::advance()
+{
+  for (size_type g = groups.size(); g > 0; --g) {
+    auto& cur = pick[g-1];
+    size_type lim = groups[g-1].members.size();
+    size_type k = cur.size();
+
+    // Next combination of the same size
+    size_type i = k;
+    while (i > 0 && cur[i-1] == lim - k + i - 1) --i;
+    if (i > 0) {
+      cur[i-1]++;
+      for (size_type j = i; j < k; ++j) cur[j] = cur[j-1] + 1;
+      descend(g);
+      return true;
+    }
+
+    // Otherwise take more members of this group
+    if (first_pick(g - 1, k + 1)) {
+      descend(g);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Produce the next invariant
+bool bool_fn::inv_stream::next(bitstr& invariant)
+{
+  if (done) return false;
+  if (!started) {
+    started = true;
+    rem[0] = target;
+    if (!reachable(0, target)) {
+      done = true;
+      return false;
+    }
+    descend(0);
+  }
+  else if (!advance()) {
+    done = true;
+    return false;
+  }
+
+  // Write out (reusing the caller's storage when possible)
+  if (invariant.bit_size != num_cycles) invariant = bitstr(num_cycles);
+  for (size_type i = 0; i < (num_cycles + bitstr::BITS_PER_BLOCK - 1) / bitstr::BITS_PER_BLOCK; ++i) {
+    invariant.blocks[i] = 0;
+  }
+  for (size_type g = 0; g < groups.size(); ++g) {
+    for (auto p : pick[g]) invariant[groups[g].members[p]] = 1;
+  }
+  return true;
+}
+
+// Get a lazy stream over the balanced invariants
+bool_fn::inv_stream bool_fn::stream_balanced_invariants() const {
+  return inv_stream(get_cycle_lengths(), (size_type(1) << out) / 2);
+}
+
+// Count balanced invariants without materialising them
+size_type bool_fn::count_balanced_invariants() const {
+  // Ensure the function is bijective
+  if (!is_bijective()) {
+    std::cerr << "Function is not bijective, cannot count balanced invariants." << std::endl;
+    return 0;
+  }
+
+  // Group cycle lengths
+  std::vector<size_type> cycle_lengths = get_cycle_lengths();
+  std::sort(cycle_lengths.begin(), cycle_lengths.end());
+
+  // Bounded knapsack over groups: ways[s] = number of subsets summing to s
+  size_type target = (size_type(1) << out) / 2;
+  std::vector<size_type> ways(target + 1, 0), next_ways(target + 1);
+  ways[0] = 1;
+  for (size_type i = 0; i < cycle_lengths.size();) {
+    size_type len = cycle_lengths[i];
+    size_type mult = 0;
+    while (i < cycle_lengths.size() && cycle_lengths[i] == len) {
+      ++mult;
+      ++i;
+    }
+
+    // Binomial coefficients C(mult, k)
+    size_type lim = std::min(mult, target / len);
+    std::vector<size_type> binom(lim + 1, 0);
+    binom[0] = 1;
+    for (size_type m = 1; m <= mult; ++m) {
+      for (size_type k = std::min(m, lim); k > 0; --k) binom[k] = sat_add(binom[k], binom[k-1]);
+    }
+
+    // next_ways[s] = sum_k C(mult, k) * ways[s - k*len]
+    parallel_for(target + 1, 1 << 14, [&](size_type beg, size_type end) {
+      for (size_type s = beg; s < end; ++s) {
+        size_type acc = 0;
+        for (size_type k = 0; k <= lim && k * len <= s; ++k) {
+          acc = sat_add(acc, sat_mul(binom[k], ways[s - k * len]));
+        }
+        next_ways[s] = acc;
+      }
+    });
+    std::swap(ways, next_ways);
+  }
+  return ways[target];
 }
 
 // Get balanced invariants
 void bool_fn::get_balanced_invariants() {
   // Ensure the function is bijective
-  if (!is_bij) {
+  if (!is_bijective()) {
     std::cerr << "Function is not bijective, cannot get balanced invariants." << std::endl;
     return; 
   }
 
-  // Create a vector to hold cycle lengths
-  std::vector<uint> cycle_lengths;
-  for (const auto& cycle : cycles) {
-    cycle_lengths.push_back(cycle.size());
-  }
-
-  // Need to get all possible subsets of cycle lengths which add up to (1<<out) / 2
+  // Drain the stream
   balanced_invariants.clear();
-  uint target_sum = (1 << out) / 2;
-  
-  // Brute force (?)
-  for (uint i = 0; i < (1 << cycles.size()); i++) {
-    bitstr invariant(cycles.size());
-    uint sum = 0;
-    for (uint j = 0; j < cycles.size(); j++) {
-      if (i & (1 << j)) {
-        sum += cycle_lengths[j];
-      }
-    }
-    if (sum == target_sum) {
-      invariant(0, cycles.size()) = i;
-      balanced_invariants.push_back(invariant);
-    }
-  } 
+  inv_stream stream = stream_balanced_invariants();
+  bitstr invariant;
+  while (stream.next(invariant)) {
+    balanced_invariants.push_back(invariant);
+  }
   return;
 }
 
 std::vector<bool_fn> bool_fn::get_inv_functions() const {
   // Ensure the function is bijective
-  if (!is_bij) {
+  if (!is_bijective()) {
     std::cerr << "Function is not bijective, cannot get inverse functions." << std::endl;
     return {};
   }
 
   // Create a vector to hold invariant functions
   std::vector<bool_fn> inv_functions;
+  inv_functions.reserve(balanced_invariants.size());
+  const auto& leads = get_cycle_leaders();
 
-  // For each balanced invariant, create a new bool_fn
+  // For each balanced invariant, create a new bool_fn (nothing is analysed until asked for)
   for (const auto& invariant : balanced_invariants) {
-    std::vector<uint> inv_values(1 << in, 0);
-    for (uint i = 0; i < (cycles.size()); i++) {
+    std::vector<uint> inv_values(size_type(1) << in, 0);
+    for (size_type i = 0; i < leads.size(); i++) {
       uint val = invariant[i];
-      for (uint j = 0; j < cycles[i].size(); j++) {
-        inv_values[cycles[i][j]] = val;
-      }
+      uint current = leads[i];
+      do {
+        inv_values[current] = val;
+        current = values[current];
+      } while (current != leads[i]);
     }
-    inv_functions.emplace_back(in, 1, inv_values);
+    inv_functions.emplace_back(in, 1, std::move(inv_values));
   }
 
   return inv_functions;
 }
 
+
+// Cached analyses
+size_type bool_fn::degree() const
+{
+  return sbox_cache::shared().lookup(*this).degree;
+}
+
+size_type bool_fn::linearity() const
+{
+  return sbox_cache::shared().lookup(*this).linearity;
+}
+
+size_type bool_fn::uniformity() const
+{
+  return sbox_cache::shared().lookup(*this).uniformity;
+}
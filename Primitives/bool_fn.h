@@ -3,10 +3,15 @@
 
 #include "sbox.h"
 #include "bitstr.h"
+#include "feistel.h"
+#include "parallel.h"
 
 #include <iostream>
 #include <vector>
+#include <atomic>
+#include <mutex>
 #include <cmath>
+#include <cstdint>
 #include <stdexcept>
 #include <format>
 
@@ -18,19 +23,33 @@ using uint = unsigned int;
 // Main class
 class bool_fn
 {
+  private:
+    // Lazily computed properties (filled on first access, not thread-safe until then)
+    mutable bool have_bij;
+    mutable bool have_cycles;
+    mutable bool have_leads;
+    mutable bool have_poly;
+    mutable bool have_walsh;
+    mutable bool is_bij;                              // true if the function is bijective
+    mutable std::vector<std::vector<uint>> cycles;    // cycles of the function (empty if not bijective)
+    mutable std::vector<uint> cycle_leads;            // smallest element of each cycle, ascending
+    mutable std::vector<size_type> cycle_lens;        // length of each cycle, same order
+    mutable std::vector<uint> poly;                   // polynomial representation of the function
+    mutable std::vector<int> walsh;                   // Walsh spectrum of the function
+
+    // Reset caches
+    void clear_cache();
+
   public:
     uint in;                                  // number of input bits
-    uint out;                                 // number of output bits (always 1 for this class)
+    uint out;                                 // number of output bits
     std::vector<uint> values;                 // values of the function, indexed by input bit patterns
-    std::vector<uint> poly;                   // polynomial representation of the function
-
-    bool is_bij;                              // true if the function is bijective, false otherwise
-    std::vector<std::vector<uint>> cycles;    // assumes the function is bijective, stores cycles of the function
     std::vector<bitstr> balanced_invariants;  // stores balanced invariants of the function
 
-    // Constructors
+    // Constructors (no analysis is run here)
     bool_fn(uint in, uint out, std::vector<uint> values);
     bool_fn(const sbox& mybox);
+    bool_fn(const feistel& cipher, size_type rounds);   // full codebook of the r-round cipher
 
     // Destructor
     ~bool_fn();
@@ -44,17 +63,67 @@ class bool_fn
     // Getting value for a specific input pattern
     uint operator[](uint input) const;
 
-    // Getting the polynomial representation
-    void get_polynomial();
+    // Getting the polynomial representation (single-output only)
+    const std::vector<uint>& get_polynomial() const;
 
     // Check for bijectivity
-    void is_bijective();
+    bool is_bijective() const;
 
     // Getting all cycles
-    void get_cycles();
+    const std::vector<std::vector<uint>>& get_cycles() const;
+
+    // Compact cycle structure (one leader and one length per cycle, cycle i of get_cycles())
+    const std::vector<uint>& get_cycle_leaders() const;
+    const std::vector<size_type>& get_cycle_lengths() const;
+
+    // Walsh spectrum, indexed by (output_mask << in) | input_mask
+    const std::vector<int>& get_walsh() const;
+
+    // Affine invariants, through the shared sbox_cache (equivalent functions are analysed once)
+    size_type degree() const;
+    size_type linearity() const;
+    size_type uniformity() const;
+
+    // Lazy enumerator over balanced invariants (subset-sum DP over cycle lengths)
+    class inv_stream
+    {
+      private:
+        // Cycles grouped by length
+        struct group
+        {
+          size_type len;                            // common cycle length
+          std::vector<size_type> members;           // indices into cycles
+        };
+        std::vector<group> groups;
+        size_type num_cycles;
+        size_type target;
+
+        // reach[g] has bit s set iff groups g.. can sum up to s
+        std::vector<std::vector<block_type>> reach;
+
+        // Enumeration state
+        std::vector<size_type> rem;                 // remaining sum before group g
+        std::vector<std::vector<size_type>> pick;   // chosen members of group g
+        bool started;
+        bool done;
+
+        bool reachable(size_type g, size_type sum) const;
+        bool first_pick(size_type g, size_type from);
+        void descend(size_type g);
+        bool advance();
+
+      public:
+        // Constructor
+        inv_stream(const std::vector<size_type>& lengths, size_type target);
+
+        // Writes the next invariant (bit i set iff cycle i is in the support)
+        bool next(bitstr& invariant);
+    };
 
     // Get balanced invariants
     void get_balanced_invariants();
+    inv_stream stream_balanced_invariants() const;
+    size_type count_balanced_invariants() const;  // saturates at SIZE_MAX
     
     // Get inv functions
     std::vector<bool_fn> get_inv_functions() const;
@@ -0,0 +1,173 @@
+// Implementation of full codebooks
+
+// Header Inclusion
+#include "codebook.h"
+#include "parallel.h"
+
+// Standard C++ Libraries
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+
+// System
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// File header
+struct codebook_header {
+  char magic[8];
+  uint64_t block_size;
+  uint64_t rounds;
+  uint64_t fingerprint;
+  uint64_t key_hash;
+  uint64_t width;
+};
+
+static const char CODEBOOK_MAGIC[8] = {'L', 'S', 'C', 'B', 'O', 'O', 'K', '2'};
+
+// Constructors
+codebook::codebook(const feistel& cipher, size_type rounds) : codebook(cipher, rounds, cipher.schedule())
+{}
+
+codebook::codebook(const feistel_ctx& ctx, size_type rounds) : codebook(*ctx.cipher, rounds, *ctx.sched)
+{}
+
+codebook::codebook(const feistel& cipher, size_type rounds, const feistel::key_schedule& key)
+  : map(nullptr), map_len(0), table(nullptr)
+{
+  if (cipher.block_size > MAX_BLOCK) {
+    throw std::invalid_argument("Codebooks need a block size of at most 32.");
+  }
+  if (rounds > cipher.max_rounds) {
+    throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+  }
+  cipher.check_key(key);
+  block_size = cipher.block_size;
+  this->rounds = rounds;
+  fingerprint = cipher.fingerprint();
+  key_hash = hash_key(key.key);
+  width = (block_size + 7) / 8;
+  owned.resize(size() * width);
+  table = owned.data();
+
+  // Encrypt in chunks (the batch path spreads each chunk over the threads)
+  const size_type CHUNK = size_type(1) << 20;
+  std::vector<uint64_t> buf(std::min(size(), CHUNK));
+  for (size_type beg = 0; beg < size(); beg += CHUNK) {
+    size_type count = std::min(CHUNK, size() - beg);
+    for (size_type i = 0; i < count; ++i) buf[i] = beg + i;
+    cipher.encrypt_batch(buf.data(), buf.data(), count, rounds, key);
+    for (size_type i = 0; i < count; ++i) std::memcpy(&owned[(beg + i) * width], &buf[i], width);
+  }
+}
+
+codebook::codebook(const std::string& path) : map(nullptr), map_len(0), table(nullptr)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::invalid_argument("Cannot open codebook file " + path + ".");
+  }
+  struct stat st;
+  codebook_header head;
+  bool ok = fstat(fd, &st) == 0 && size_type(st.st_size) >= sizeof(head) &&
+            pread(fd, &head, sizeof(head), 0) == ssize_t(sizeof(head)) &&
+            std::memcmp(head.magic, CODEBOOK_MAGIC, sizeof(head.magic)) == 0 &&
+            head.block_size <= MAX_BLOCK && head.width == (head.block_size + 7) / 8 &&
+            size_type(st.st_size) == sizeof(head) + (size_type(1) << head.block_size) * head.width;
+  if (!ok) {
+    close(fd);
+    throw std::invalid_argument("Not a codebook file: " + path + ".");
+  }
+  block_size = head.block_size;
+  rounds = head.rounds;
+  fingerprint = head.fingerprint;
+  key_hash = head.key_hash;
+  width = head.width;
+
+  map_len = st.st_size;
+  map = mmap(nullptr, map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    map = nullptr;
+    throw std::runtime_error("Cannot map codebook file " + path + ".");
+  }
+  table = static_cast<const uint8_t*>(map) + sizeof(head);
+}
+
+codebook::~codebook()
+{
+  if (map) munmap(map, map_len);
+}
+
+// Key hash (FNV-1a over the size and the bits)
+uint64_t codebook::hash_key(const bitstr& key)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  auto mix = [&](uint64_t v) {
+    h ^= v;
+    h *= 0x100000001b3ULL;
+  };
+  mix(key.bit_size);
+  for (unsigned i = 0; i < key.bit_size; ++i) mix(key[i]);
+  return h;
+}
+
+// Sizes
+size_type codebook::size() const
+{
+  return size_type(1) << block_size;
+}
+
+bool codebook::mapped() const
+{
+  return map != nullptr;
+}
+
+// Lookups
+uint64_t codebook::lookup(uint64_t plaintext) const
+{
+  // Bits above the block size are ignored, so any input stays in the table
+  uint64_t result = 0;
+  std::memcpy(&result, table + (plaintext & (size() - 1)) * width, width);
+  return result;
+}
+
+bitstr codebook::encrypt(const bitstr& input) const
+{
+  if (input.bit_size != block_size) {
+    throw std::invalid_argument("Input size must match the block size.");
+  }
+  return bitstr(block_type(lookup(input.value(0, block_size))), block_size);
+}
+
+void codebook::encrypt_batch(const uint64_t* input, uint64_t* output, size_type count) const
+{
+  parallel_for(count, 1 << 16, [&](size_type beg, size_type end) {
+    for (size_type i = beg; i < end; ++i) output[i] = lookup(input[i]);
+  });
+}
+
+// Save
+void codebook::save(const std::string& path) const
+{
+  codebook_header head;
+  std::memcpy(head.magic, CODEBOOK_MAGIC, sizeof(head.magic));
+  head.block_size = block_size;
+  head.rounds = rounds;
+  head.fingerprint = fingerprint;
+  head.key_hash = key_hash;
+  head.width = width;
+
+  // Write beside the target and rename, so maps of the old file stay valid
+  std::string tmp = path + ".tmp." + std::to_string(getpid());
+  std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+  out.write(reinterpret_cast<const char*>(table), size() * width);
+  out.close();
+  if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("Cannot write codebook file " + path + ".");
+  }
+}
@@ -0,0 +1,79 @@
+// Full codebook of a small-block Feistel instance: the ciphertext of
+// every plaintext under one key and round count, built once with batch
+// encryption and then queried by table lookup
+
+/*
+ * STORAGE:
+ * Entry p is the ciphertext of the packed plaintext p (as in
+ * encrypt_batch), stored little-endian in the fewest whole bytes that
+ * hold a block. Block sizes are limited to 32 bits, i.e. at most 16 GiB
+ * for a full 32-bit codebook.
+ */
+
+/*
+ * FILES:
+ * save writes a small header (block size, rounds, cipher fingerprint,
+ * key hash, entry width) followed by the table; the path constructor maps
+ * such a file read-only instead of loading it, so large codebooks are
+ * paged in on demand and shared between processes. The file is written
+ * under a temporary name and renamed into place, so a codebook mapped
+ * from the same path stays intact.
+ */
+
+#ifndef CODEBOOK_H
+#define CODEBOOK_H
+
+// Custom Libraries
+#include "bitstr.h"
+#include "feistel.h"
+
+// Standard C++ Libraries
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+
+// Class
+class codebook {
+  public:
+    static constexpr size_type MAX_BLOCK = 32;
+
+    size_type block_size;
+    size_type rounds;
+    uint64_t fingerprint;     // of the cipher description (not the key)
+    uint64_t key_hash;        // of the master key (see hash_key)
+    size_type width;          // bytes per entry
+
+    // Constructors (encrypt the whole plaintext space, or map a saved codebook)
+    codebook(const feistel& cipher, size_type rounds);
+    codebook(const feistel& cipher, size_type rounds, const feistel::key_schedule& key);
+    codebook(const feistel_ctx& ctx, size_type rounds);
+    explicit codebook(const std::string& path);
+    ~codebook();
+
+    codebook(const codebook&) = delete;
+    codebook& operator=(const codebook&) = delete;
+
+    // Hash of a master key, to tell which key a codebook was built under
+    static uint64_t hash_key(const bitstr& key);
+
+    // Number of entries (2^block_size)
+    size_type size() const;
+    bool mapped() const;
+
+    // Lookups (plaintext bits above block_size are ignored)
+    uint64_t lookup(uint64_t plaintext) const;
+    bitstr encrypt(const bitstr& input) const;
+    void encrypt_batch(const uint64_t* input, uint64_t* output, size_type count) const;
+
+    // Write to a file for the path constructor
+    void save(const std::string& path) const;
+
+  private:
+    std::vector<uint8_t> owned;
+    void* map;
+    size_type map_len;
+    const uint8_t* table;
+};
+
+#endif
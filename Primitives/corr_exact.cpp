@@ -0,0 +1,238 @@
+// Implementation of exact correlations from full codebooks
+
+// Header Inclusion
+#include "corr_exact.h"
+
+// Standard C++ Libraries
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+
+// System
+#include <unistd.h>
+
+// Helpers
+// Byte tables of a gather on packed integers (see key_sched.cpp)
+static std::vector<uint64_t> byte_tables(const std::vector<size_type>& table, size_type in)
+{
+  size_type out = table.size();
+  size_type chunks = (in + 7) / 8;
+  std::vector<uint64_t> tab(chunks * 256, 0);
+  for (size_type i = 0; i < out; ++i) {
+    size_type b = in - 1 - table[i];
+    for (size_type v = 0; v < 256; ++v) {
+      if ((v >> (b % 8)) & 1) tab[(b / 8) * 256 + v] |= uint64_t(1) << (out - 1 - i);
+    }
+  }
+  return tab;
+}
+
+static inline uint64_t lookup(const std::vector<uint64_t>& tab, uint64_t x)
+{
+  uint64_t result = 0;
+  for (size_type c = 0; c < tab.size() / 256; ++c) result |= tab[c * 256 + ((x >> (8 * c)) & 0xff)];
+  return result;
+}
+
+static inline int parity(uint64_t x)
+{
+  return __builtin_popcountll(x) & 1;
+}
+
+// In-place Walsh transform: the stages that stay within a cache-sized block
+// run block by block, the rest two stages per pass
+static void fwht(int64_t* row, size_type size)
+{
+  const size_type BLOCK = std::min<size_type>(size, 1 << 12);
+  for (size_type base = 0; base < size; base += BLOCK) {
+    for (size_type h = 1; h < BLOCK; h <<= 1) {
+      for (size_type i = base; i < base + BLOCK; i += 2 * h) {
+        for (size_type j = i; j < i + h; ++j) {
+          int64_t u = row[j];
+          int64_t v = row[j + h];
+          row[j] = u + v;
+          row[j + h] = u - v;
+        }
+      }
+    }
+  }
+  for (size_type h = BLOCK; h < size; h <<= 2) {
+    if (4 * h > size) {
+      for (size_type j = 0; j < h; ++j) {
+        int64_t u = row[j];
+        int64_t v = row[j + h];
+        row[j] = u + v;
+        row[j + h] = u - v;
+      }
+      break;
+    }
+    for (size_type i = 0; i < size; i += 4 * h) {
+      for (size_type j = i; j < i + h; ++j) {
+        int64_t a = row[j], b = row[j + h], c = row[j + 2 * h], d = row[j + 3 * h];
+        row[j] = (a + b) + (c + d);
+        row[j + h] = (a - b) + (c - d);
+        row[j + 2 * h] = (a + b) - (c + d);
+        row[j + 3 * h] = (a - b) - (c - d);
+      }
+    }
+  }
+}
+
+// Constructors
+corr_exact::corr_exact(std::shared_ptr<const codebook> book)
+{
+  if (!book) throw std::invalid_argument("Exact correlations need a codebook.");
+  this->book = book;
+  block_size = book->block_size;
+}
+
+corr_exact::corr_exact(std::shared_ptr<const codebook> book, const feistel& cipher) : corr_exact(book)
+{
+  if (book->block_size != cipher.block_size || book->fingerprint != cipher.fingerprint()) {
+    throw std::invalid_argument("Codebook was built for a different cipher.");
+  }
+  if (!cipher.fp.if_minv) {
+    throw std::invalid_argument("Final permutation must be invertible.");
+  }
+
+  // Input masks scatter through ip: a . x.permute(ip) = a.sinv_permute(ip) . x
+  std::vector<size_type> scatter(block_size);
+  for (size_type i = 0; i < block_size; ++i) scatter[cipher.ip.main_table[i]] = i;
+  in_tab = byte_tables(scatter, block_size);
+
+  // Ciphertexts are gathered through the inverse of fp once
+  std::vector<uint64_t> out_tab = byte_tables(cipher.fp.minv_table, block_size);
+  inner.resize(book->size());
+  parallel_for(book->size(), 1 << 16, [&](size_type beg, size_type end) {
+    for (size_type x = beg; x < end; ++x) inner[x] = lookup(out_tab, book->lookup(x));
+  });
+}
+
+// Helpers
+// Workers that may each hold a row (half the physical memory, at least one)
+size_type corr_exact::row_workers() const
+{
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long page = sysconf(_SC_PAGE_SIZE);
+  size_type budget = (pages > 0 && page > 0) ? size_type(pages) * size_type(page) / 2 : size_type(1) << 32;
+  size_type per_row = book->size() * sizeof(int64_t);
+  return std::max<size_type>(1, std::min(thread_count(), budget / per_row));
+}
+
+uint64_t corr_exact::input_mask(uint64_t in_mask) const
+{
+  if (in_mask >= book->size()) {
+    throw std::invalid_argument("Mask does not fit the block size.");
+  }
+  return in_tab.empty() ? in_mask : lookup(in_tab, in_mask);
+}
+
+uint64_t corr_exact::target(uint64_t x) const
+{
+  return inner.empty() ? book->lookup(x) : inner[x];
+}
+
+void corr_exact::fill_row(uint64_t in_mask, int64_t* row) const
+{
+  uint64_t a = input_mask(in_mask);
+  size_type size = book->size();
+  std::fill(row, row + size, 0);
+  for (size_type x = 0; x < size; ++x) row[target(x)] += parity(a & x) ? -1 : 1;
+  fwht(row, size);
+}
+
+int64_t corr_exact::pair_sum(uint64_t raw_in, uint64_t out_mask, size_type beg, size_type end) const
+{
+  int64_t odd = 0;
+  for (size_type x = beg; x < end; ++x) odd += parity((raw_in & x) ^ (out_mask & target(x)));
+  return int64_t(end - beg) - 2 * odd;
+}
+
+// Walsh row
+std::vector<int64_t> corr_exact::row(uint64_t in_mask) const
+{
+  std::vector<int64_t> result(book->size());
+  fill_row(in_mask, result.data());
+  return result;
+}
+
+// Best output masks
+std::vector<std::pair<uint64_t, double>> corr_exact::best(const std::vector<uint64_t>& in_masks) const
+{
+  std::vector<std::pair<uint64_t, double>> result(in_masks.size());
+  double scale = 1.0 / double(book->size());
+  rows(in_masks, [&](size_type i, const int64_t* w) {
+    size_type arg = 0;
+    for (size_type b = 1; b < book->size(); ++b) {
+      if (std::llabs(w[b]) > std::llabs(w[arg])) arg = b;
+    }
+    result[i] = {arg, double(w[arg]) * scale};
+  });
+  return result;
+}
+
+// Single pairs
+double corr_exact::correlation(uint64_t in_mask, uint64_t out_mask) const
+{
+  uint64_t a = input_mask(in_mask);
+  if (out_mask >= book->size()) {
+    throw std::invalid_argument("Mask does not fit the block size.");
+  }
+  std::atomic<int64_t> total(0);
+  parallel_for(book->size(), 1 << 16, [&](size_type beg, size_type end) {
+    total += pair_sum(a, out_mask, beg, end);
+  });
+  return double(total.load()) / double(book->size());
+}
+
+double corr_exact::correlation(const bitstr& in_mask, const bitstr& out_mask) const
+{
+  if (in_mask.bit_size != block_size || out_mask.bit_size != block_size) {
+    throw std::invalid_argument("Mask sizes must match the block size.");
+  }
+  return correlation(in_mask.value(0, block_size), out_mask.value(0, block_size));
+}
+
+// Chosen pairs
+std::vector<double> corr_exact::correlations(const std::vector<std::pair<uint64_t, uint64_t>>& pairs) const
+{
+  for (const auto& [a, b] : pairs) {
+    if (a >= book->size() || b >= book->size()) {
+      throw std::invalid_argument("Mask does not fit the block size.");
+    }
+  }
+
+  // Group pairs by input mask
+  std::vector<size_type> order(pairs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_type x, size_type y) { return pairs[x].first < pairs[y].first; });
+  std::vector<size_type> starts;
+  for (size_type k = 0; k < order.size(); ++k) {
+    if (k == 0 || pairs[order[k]].first != pairs[order[k - 1]].first) starts.push_back(k);
+  }
+  starts.push_back(order.size());
+
+  // A row costs about block_size / 2 direct sums
+  std::vector<double> result(pairs.size());
+  double scale = 1.0 / double(book->size());
+  size_type groups = starts.size() - 1;
+  size_type per_worker = (groups + row_workers() - 1) / row_workers();
+  parallel_for(groups, per_worker, [&](size_type beg, size_type end) {
+    std::vector<int64_t> buf;
+    for (size_type g = beg; g < end; ++g) {
+      size_type lo = starts[g], hi = starts[g + 1];
+      uint64_t a = pairs[order[lo]].first;
+      if (2 * (hi - lo) > block_size) {
+        buf.resize(book->size());
+        fill_row(a, buf.data());
+        for (size_type k = lo; k < hi; ++k) result[order[k]] = double(buf[pairs[order[k]].second]) * scale;
+      } else {
+        uint64_t raw = input_mask(a);
+        for (size_type k = lo; k < hi; ++k) {
+          result[order[k]] = double(pair_sum(raw, pairs[order[k]].second, 0, book->size())) * scale;
+        }
+      }
+    }
+  });
+  return result;
+}
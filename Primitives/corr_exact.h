@@ -0,0 +1,97 @@
+// Exact linear correlations of a small-block cipher from its full
+// codebook: every output mask of an input mask with one fast Walsh
+// transform, or chosen (input, output) mask pairs
+
+/*
+ * SPECTRUM:
+ * For an input mask a, f[y] = sum over x with E(x) = y of (-1)^(a.x)
+ * is a signed count on the outputs (a +-1 indicator when E is a
+ * permutation), and its Walsh transform at b is
+ * W(a, b) = sum_x (-1)^(a.x + b.E(x)). One row (all 2^n output masks)
+ * thus costs O(n 2^n); the correlation is W / 2^n and the bias half of
+ * that. Rows for many input masks are computed in parallel, one per
+ * thread at a time.
+ */
+
+/*
+ * MEMORY:
+ * A row is 2^n int64_t (32 GiB at n = 32) and every worker holds one, so
+ * rows and correlations run only as many workers as half the physical
+ * memory has room for (at least one). A single row still has to fit.
+ */
+
+/*
+ * MASKS:
+ * Masks are packed as by bitstr(value, block_size). Built with the
+ * cipher, they apply to the state after ip and before fp, as in attack
+ * and trail (pt.permute(ip), ct.inv_permute(fp)); built from the
+ * codebook alone, they apply to the plaintext and ciphertext as is.
+ */
+
+#ifndef CORR_EXACT_H
+#define CORR_EXACT_H
+
+// Custom Libraries
+#include "bitstr.h"
+#include "feistel.h"
+#include "codebook.h"
+#include "parallel.h"
+
+// Standard C++ Libraries
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <stdexcept>
+
+// Class
+class corr_exact {
+  public:
+    std::shared_ptr<const codebook> book;
+    size_type block_size;
+
+    // Constructors (raw masks, or masks between ip and fp of the cipher)
+    corr_exact(std::shared_ptr<const codebook> book);
+    corr_exact(std::shared_ptr<const codebook> book, const feistel& cipher);
+
+    // Walsh row of an input mask: entry b is W(in_mask, b)
+    std::vector<int64_t> row(uint64_t in_mask) const;
+
+    // Rows of many input masks in parallel: fn(index, row) is called once per
+    // mask (concurrently, row is only valid during the call)
+    template <typename Fn>
+    void rows(const std::vector<uint64_t>& in_masks, Fn fn) const
+    {
+      for (uint64_t a : in_masks) input_mask(a);
+      size_type per_worker = (in_masks.size() + row_workers() - 1) / row_workers();
+      parallel_for(in_masks.size(), per_worker, [&](size_type beg, size_type end) {
+        std::vector<int64_t> buf(book->size());
+        for (size_type i = beg; i < end; ++i) {
+          fill_row(in_masks[i], buf.data());
+          fn(i, static_cast<const int64_t*>(buf.data()));
+        }
+      });
+    }
+
+    // Best output mask (largest |W|, first on ties) of every input mask
+    std::vector<std::pair<uint64_t, double>> best(const std::vector<uint64_t>& in_masks) const;
+
+    // Correlations of single pairs, or of a chosen set (pairs sharing an
+    // input mask go through its row when there are enough of them)
+    double correlation(uint64_t in_mask, uint64_t out_mask) const;
+    double correlation(const bitstr& in_mask, const bitstr& out_mask) const;
+    std::vector<double> correlations(const std::vector<std::pair<uint64_t, uint64_t>>& pairs) const;
+
+  private:
+    std::vector<uint64_t> in_tab;             // byte tables: inner input mask -> plaintext mask
+    std::vector<uint32_t> inner;              // ciphertext of x after fp inverse (empty if raw)
+
+    // Helpers
+    size_type row_workers() const;
+    uint64_t input_mask(uint64_t in_mask) const;
+    uint64_t target(uint64_t x) const;
+    void fill_row(uint64_t in_mask, int64_t* row) const;
+    int64_t pair_sum(uint64_t raw_in, uint64_t out_mask, size_type beg, size_type end) const;
+};
+
+#endif
@@ -2,6 +2,8 @@
 
 // Header Inclusion
 #include "feistel.h"
+#include "feistel_bs.h"
+#include "parallel.h"
 
 // Constructor
 feistel::feistel() 
@@ -65,16 +67,229 @@ feistel::feistel(size_type block_size, size_type max_rounds, size_type key_size,
     }
   }
   this->round_sch = round_sch;
+
+  // SP tables
+  build_sp();
+}
+
+feistel::feistel(size_type block_size, size_type max_rounds, size_type key_size,
+            const perm& ip, const perm& fp,
+            const std::vector<sbox>& sboxes,
+            const perm& rf_before, const perm& rf_after,
+            const rotating_schedule& schedule)
+  : feistel(block_size, max_rounds, key_size, ip, fp, sboxes, rf_before, rf_after, schedule.tables())
+{
+  if (schedule.key_size() != key_size) {
+    throw std::invalid_argument("Key schedule must match the key size.");
+  }
+  key_proc = std::make_shared<const rotating_schedule>(schedule);
+}
+
+// Helpers
+// Bits [pos, pos + len) of a bitstr word array, bit pos first (len < 64)
+static size_type raw_bits(const block_type* words, size_type pos, size_type len)
+{
+  const size_type W = bitstr::BITS_PER_BLOCK;
+  block_type value = words[pos / W] >> (pos % W);
+  if (pos % W + len > W) value |= words[pos / W + 1] << (W - pos % W);
+  return value & ((block_type(1) << len) - 1);
+}
+
+// Build the unkeyed SP tables and the input extractors
+void feistel::build_sp()
+{
+  const size_type W = bitstr::BITS_PER_BLOCK;
+  size_type half = block_size / 2;
+  half_words = (half + W - 1) / W;
+
+  // Entries per S-Box
+  sp_offset.clear();
+  sp_entries = 0;
+  for (const auto& box : sboxes) {
+    sp_offset.push_back(sp_entries);
+    sp_entries += size_type(1) << box.input_size;
+  }
+  sp_tab.assign(sp_entries * half_words, 0);
+
+  // Bit i of the half is output bit rf_after[i] of the S-Box layer
+  size_type op_start = 0;
+  for (size_type s = 0; s < sboxes.size(); ++s) {
+    const sbox& box = sboxes[s];
+    size_type ip_sz = box.input_size;
+    for (size_type u = 0; u < (size_type(1) << ip_sz); ++u) {
+      // Gather order to value (bit t of u is the t-th most significant input bit)
+      size_type x = 0;
+      for (size_type t = 0; t < ip_sz; ++t) x |= ((u >> t) & 1) << (ip_sz - 1 - t);
+      size_type y = box[x];
+      block_type* entry = sp_tab.data() + (sp_offset[s] + u) * half_words;
+      for (size_type i = 0; i < half; ++i) {
+        size_type src = rf_after.main_table[i];
+        if (src < op_start || src >= op_start + box.output_size) continue;
+        if ((y >> (box.output_size - 1 - (src - op_start))) & 1) {
+          entry[i / W] |= block_type(1) << (i % W);
+        }
+      }
+    }
+    op_start += box.output_size;
+  }
+
+  // Extractors: input bit t of an S-Box is half bit rf_before[start + t]
+  sp_runs.clear();
+  sp_run_start.assign(1, 0);
+  size_type start = 0;
+  for (const auto& box : sboxes) {
+    for (size_type t = 0; t < box.input_size; ++t) {
+      size_type pos = rf_before.main_table[start + t];
+      bool extend = sp_runs.size() > sp_run_start.back();
+      if (extend) {
+        const sp_run& last = sp_runs.back();
+        size_type len = __builtin_popcountl(last.mask);
+        extend = (last.word == pos / W) && (last.shift + len == pos % W) && (last.dst + len == t);
+      }
+      if (extend) {
+        sp_runs.back().mask = (sp_runs.back().mask << 1) | 1;
+      }
+      else {
+        sp_runs.push_back({pos / W, pos % W, t, block_type(1)});
+      }
+    }
+    sp_run_start.push_back(sp_runs.size());
+    start += box.input_size;
+  }
+}
+
+// Gather-order input of S-Box s, read from the half block through its runs
+size_type feistel::sbox_input(size_type s, const block_type* half) const
+{
+  size_type u = 0;
+  for (size_type k = sp_run_start[s]; k < sp_run_start[s+1]; ++k) {
+    const sp_run& run = sp_runs[k];
+    u |= ((half[run.word] >> run.shift) & run.mask) << run.dst;
+  }
+  return u;
 }
 
 // Assign a key to the Feistel cipher
 void feistel::assign_key(const bitstr& key)
+{
+  use_key(expand_key(key));
+  return;
+}
+
+// Expand a key: round keys and their S-Box slices
+std::shared_ptr<const feistel::key_schedule> feistel::expand_key(const bitstr& key) const
 {
   if (key.bit_size != key_size) {
     throw std::invalid_argument("Key size does not match the cipher's key size.");
   }
-  this->key = key;
-  return;
+  auto result = std::make_shared<key_schedule>();
+  result->key = key;
+  result->sbox_keys.reserve(max_rounds * sboxes.size());
+
+  std::vector<bitstr> proc_keys;
+  if (key_proc) proc_keys = key_proc->expand(key);
+
+  for (size_type r = 0; r < max_rounds; ++r) {
+    bitstr round = key_proc ? std::move(proc_keys[r]) : key.substitute(round_sch[r], round_sch[r].size());
+    if (round.bit_size != rf_before.op_size) {
+      throw std::invalid_argument("Round key must match size of permuted input.");
+    }
+
+    // Round key slice of every S-Box, in gather order
+    size_type start = 0;
+    for (size_type s = 0; s < sboxes.size(); ++s) {
+      size_type ip_sz = sboxes[s].input_size;
+      result->sbox_keys.push_back(raw_bits(round.blocks, start, ip_sz));
+      start += ip_sz;
+    }
+    result->round_keys.push_back(std::move(round));
+  }
+  return result;
+}
+
+// Check that a schedule was expanded for this cipher
+void feistel::check_key(const key_schedule& schedule) const
+{
+  if (schedule.key.bit_size != key_size || schedule.round_keys.size() != max_rounds ||
+      schedule.sbox_keys.size() != max_rounds * sboxes.size()) {
+    throw std::invalid_argument("Key schedule does not belong to this cipher.");
+  }
+}
+
+// Switch to a pre-expanded key
+void feistel::use_key(std::shared_ptr<const key_schedule> schedule)
+{
+  if (!schedule) {
+    throw std::invalid_argument("Key schedule does not belong to this cipher.");
+  }
+  check_key(*schedule);
+  sched = std::move(schedule);
+}
+
+// Currently used key (null if none was assigned)
+std::shared_ptr<const feistel::key_schedule> feistel::current_key() const
+{
+  return sched;
+}
+
+// Shared copy of the description (specialised ciphers override this to keep their type)
+std::shared_ptr<const feistel> feistel::share() const
+{
+  return std::make_shared<const feistel>(*this);
+}
+
+// Currently used key (throws if none was assigned)
+const feistel::key_schedule& feistel::schedule() const
+{
+  if (!sched) {
+    throw std::logic_error("No key has been assigned.");
+  }
+  return *sched;
+}
+
+// FNV-1a over every table of the description
+uint64_t feistel::fingerprint() const
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  auto mix = [&](uint64_t v) {
+    for (size_type i = 0; i < 8; ++i) {
+      h ^= (v >> (8 * i)) & 0xff;
+      h *= 0x100000001b3ULL;
+    }
+  };
+  auto mix_perm = [&](const perm& p) {
+    mix(p.ip_size);
+    mix(p.op_size);
+    for (auto v : p.main_table) mix(v);
+  };
+
+  mix(block_size);
+  mix(max_rounds);
+  mix(key_size);
+  mix_perm(ip);
+  mix_perm(fp);
+  mix_perm(rf_before);
+  mix_perm(rf_after);
+  mix(sboxes.size());
+  for (const auto& box : sboxes) {
+    mix(box.input_size);
+    mix(box.output_size);
+    for (size_type x = 0; x < (size_type(1) << box.input_size); ++x) mix(box[x]);
+  }
+  for (const auto& round : round_sch) {
+    mix(round.size());
+    for (auto v : round) mix(v);
+  }
+  return h;
+}
+
+// Round key for a given round
+const bitstr& feistel::round_key(size_type round) const
+{
+  if (round >= max_rounds) {
+    throw std::invalid_argument("Round exceeds maximum allowed.");
+  }
+  return schedule().round_keys[round];
 }
 
 // Round Function
@@ -84,44 +299,76 @@ bitstr feistel::rfunc(const bitstr& input, const bitstr& round) const
     throw std::invalid_argument("Input size must match half of the block size.");
   }
   
-  // Apply the initial permutation
-  bitstr permuted_input = input.permute(rf_before);
-
-  // Add round key
-  if (permuted_input.bit_size != round.bit_size) {
+  if (round.bit_size != rf_before.op_size) {
     throw std::invalid_argument("Round key must match size of permuted input.");
   }
-  permuted_input ^= round;
-  
-  // Apply SBoxes
-  bitstr sbox_output(0);
+
+  // S-Box inputs straight from the half, S-Boxes and the final permutation in one go
+  bitstr final_output(block_size / 2);
   size_type start = 0;
-  for (auto it = sboxes.begin(); it != sboxes.end(); ++it) {
-    // Get s-box input size and extract
-    size_type ip_sz = it->input_size;
-    size_type input = permuted_input.value(start, start + ip_sz);
-
-    // Feed
-    size_type output = (*it)[input];
-    
-    // Append to output
-    sbox_output += bitstr(block_type(output), it->output_size);
+  for (size_type s = 0; s < sboxes.size(); ++s) {
+    size_type ip_sz = sboxes[s].input_size;
+    size_type u = sbox_input(s, input.blocks) ^ raw_bits(round.blocks, start, ip_sz);
+    const block_type* entry = sp_tab.data() + (sp_offset[s] + u) * half_words;
+    for (size_type w = 0; w < half_words; ++w) final_output.blocks[w] ^= entry[w];
     start += ip_sz;
   }
-
-  // Apply the final permutation
-  bitstr final_output = sbox_output.permute(rf_after);
   return final_output;
 }
 
+// One round through the SP tables under a key: left ^= f(right)
+void feistel::keyed_round(const key_schedule& key, block_type* left, const block_type* right, size_type round) const
+{
+  const size_type* keys = key.sbox_keys.data() + round * sboxes.size();
+  for (size_type s = 0; s < sboxes.size(); ++s) {
+    const block_type* entry = sp_tab.data() + (sp_offset[s] + (sbox_input(s, right) ^ keys[s])) * half_words;
+    for (size_type w = 0; w < half_words; ++w) left[w] ^= entry[w];
+  }
+}
+
+// Keyed round that records the S-Box inputs and outputs (as integer values)
+void feistel::traced_round(const key_schedule& key, block_type* left, const block_type* right, size_type round,
+                           size_type* sbox_in, size_type* sbox_out) const
+{
+  const size_type* keys = key.sbox_keys.data() + round * sboxes.size();
+  for (size_type s = 0; s < sboxes.size(); ++s) {
+    size_type g = sbox_input(s, right) ^ keys[s];
+    const block_type* entry = sp_tab.data() + (sp_offset[s] + g) * half_words;
+    for (size_type w = 0; w < half_words; ++w) left[w] ^= entry[w];
+
+    // Gather order back to the integer value
+    size_type ip_sz = sboxes[s].input_size;
+    size_type x = 0;
+    for (size_type t = 0; t < ip_sz; ++t) x |= ((g >> t) & 1) << (ip_sz - 1 - t);
+    sbox_in[s] = x;
+    sbox_out[s] = sboxes[s][x];
+  }
+}
+
 // Encrypt a block of data
-bitstr feistel::encrypt(const bitstr& input, size_type rounds) const{
+bitstr feistel::encrypt(const bitstr& input, size_type rounds) const
+{
+  if (!sched) return encrypt_under(input, rounds, nullptr);
+  return encrypt(input, rounds, *sched);
+}
+
+bitstr feistel::encrypt(const bitstr& input, size_type rounds, const key_schedule& key) const
+{
+  check_key(key);
+  return encrypt_under(input, rounds, &key);
+}
+
+bitstr feistel::encrypt_under(const bitstr& input, size_type rounds, const key_schedule* key) const
+{
   if (input.bit_size != block_size) {
     throw std::invalid_argument("Input size must match the block size.");
   }
   if (rounds > max_rounds) {
     throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
   }
+  if (rounds > 0 && !key) {
+    throw std::logic_error("No key has been assigned.");
+  }
 
   // Initial permutation
   bitstr permuted_input = input.permute(ip);
@@ -132,14 +379,8 @@ bitstr feistel::encrypt(const bitstr& input, size_type rounds) const{
 
   // Perform rounds
   for (size_type i = 0; i < rounds; ++i) {
-    // Get the round key
-    bitstr round = key.substitute(round_sch[i], round_sch[i].size());
-
-    // Apply round function to right half
-    bitstr rf_output = rfunc(right, round);
-
-    // XOR with left half
-    left ^= rf_output;
+    // Round function through the SP tables under the key, XORed into the left half
+    keyed_round(*key, left.blocks, right.blocks, i);
 
     // Swap halves for next round
     if (i < rounds - 1) { // No swap on the last round
@@ -155,13 +396,29 @@ bitstr feistel::encrypt(const bitstr& input, size_type rounds) const{
 }
 
 // Decrypt a block of data
-bitstr feistel::decrypt(const bitstr& input, size_type rounds) const {
+bitstr feistel::decrypt(const bitstr& input, size_type rounds) const
+{
+  if (!sched) return decrypt_under(input, rounds, nullptr);
+  return decrypt(input, rounds, *sched);
+}
+
+bitstr feistel::decrypt(const bitstr& input, size_type rounds, const key_schedule& key) const
+{
+  check_key(key);
+  return decrypt_under(input, rounds, &key);
+}
+
+bitstr feistel::decrypt_under(const bitstr& input, size_type rounds, const key_schedule* key) const
+{
   if (input.bit_size != block_size) {
     throw std::invalid_argument("Input size must match the block size.");
   }
   if (rounds > max_rounds) {
     throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
   }
+  if (rounds > 0 && !key) {
+    throw std::logic_error("No key has been assigned.");
+  }
 
   // Initial permutation
   bitstr permuted_input = input.inv_permute(fp);
@@ -172,15 +429,8 @@ bitstr feistel::decrypt(const bitstr& input, size_type rounds) const {
 
   // Perform rounds in reverse order
   for (size_type i = rounds; i > 0; i--) {
-
-    // Get the round key
-    bitstr round = key.substitute(round_sch[i-1], round_sch[i-1].size());
-
-    // Apply round function to right half
-    bitstr rf_output = rfunc(right, round);
-
-    // XOR with left half
-    left ^= rf_output;
+    // Round function through the SP tables under the key, XORed into the left half
+    keyed_round(*key, left.blocks, right.blocks, i-1);
 
     // Swap halves for next round
     if (i > 1) { // No swap on the first round
@@ -195,3 +445,205 @@ bitstr feistel::decrypt(const bitstr& input, size_type rounds) const {
   return final_output;
 }
 
+// Batch helper: full groups of lanes through the bitsliced engine (in parallel),
+// the rest one by one. The first group runs on the calling thread so that
+// errors surface as exceptions here.
+static void run_batch(const feistel& cipher, const feistel::key_schedule& key, bool dec,
+                      const uint64_t* input, uint64_t* output, size_type count, size_type rounds)
+{
+  if (cipher.block_size > 64) {
+    throw std::invalid_argument("Batch APIs need a block size of at most 64.");
+  }
+  if (rounds > cipher.max_rounds) {
+    throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+  }
+  const size_type LANES = feistel_bs_native::LANES;
+  size_type groups = count / LANES;
+
+  if (groups > 0) {
+    feistel_bs_native engine(cipher, key);
+    auto run = [&](size_type g) {
+      if (dec) engine.decrypt(input + g * LANES, output + g * LANES, rounds);
+      else engine.encrypt(input + g * LANES, output + g * LANES, rounds);
+    };
+    run(0);
+    parallel_for(groups - 1, 16, [&](size_type beg, size_type end) {
+      for (size_type g = beg + 1; g <= end; ++g) run(g);
+    });
+  }
+
+  // Remaining blocks
+  for (size_type i = groups * LANES; i < count; ++i) {
+    bitstr block(block_type(input[i]), cipher.block_size);
+    bitstr result = dec ? cipher.decrypt(block, rounds, key) : cipher.encrypt(block, rounds, key);
+    output[i] = result.value(0, cipher.block_size);
+  }
+}
+
+// Encrypt a batch of packed blocks
+void feistel::encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const
+{
+  encrypt_batch(input, output, count, rounds, schedule());
+}
+
+void feistel::encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds,
+                            const key_schedule& key) const
+{
+  check_key(key);
+  run_batch(*this, key, false, input, output, count, rounds);
+}
+
+// Decrypt a batch of packed blocks
+void feistel::decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const
+{
+  decrypt_batch(input, output, count, rounds, schedule());
+}
+
+void feistel::decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds,
+                            const key_schedule& key) const
+{
+  check_key(key);
+  run_batch(*this, key, true, input, output, count, rounds);
+}
+
+// Traced encryption of a block
+void feistel::encrypt_trace(const bitstr& input, size_type rounds, std::vector<round_trace>& trace) const
+{
+  encrypt_trace(input, rounds, trace, schedule());
+}
+
+void feistel::encrypt_trace(const bitstr& input, size_type rounds, std::vector<round_trace>& trace,
+                            const key_schedule& key) const
+{
+  check_key(key);
+  if (input.bit_size != block_size) {
+    throw std::invalid_argument("Input size must match the block size.");
+  }
+  if (rounds > max_rounds) {
+    throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+  }
+
+  // Initial permutation and halves
+  bitstr permuted_input = input.permute(ip);
+  bitstr left = permuted_input.extract(0, block_size / 2);
+  bitstr right = permuted_input.extract(block_size / 2, block_size);
+
+  // Rounds, recording the state after each
+  trace.resize(rounds);
+  for (size_type i = 0; i < rounds; ++i) {
+    round_trace& rt = trace[i];
+    rt.sbox_in.resize(sboxes.size());
+    rt.sbox_out.resize(sboxes.size());
+    traced_round(key, left.blocks, right.blocks, i, rt.sbox_in.data(), rt.sbox_out.data());
+    rt.left = left;
+    rt.right = right;
+    if (i < rounds - 1) std::swap(left, right);
+  }
+}
+
+// Words per block and round in a batch trace
+size_type feistel::trace_stride() const
+{
+  return 2 + 2 * sboxes.size();
+}
+
+// Traced encryption of a batch of packed blocks
+void feistel::encrypt_trace_batch(const uint64_t* input, uint64_t* trace, size_type count, size_type rounds) const
+{
+  encrypt_trace_batch(input, trace, count, rounds, schedule());
+}
+
+void feistel::encrypt_trace_batch(const uint64_t* input, uint64_t* trace, size_type count, size_type rounds,
+                                  const key_schedule& key) const
+{
+  check_key(key);
+  if (block_size > 64) {
+    throw std::invalid_argument("Batch APIs need a block size of at most 64.");
+  }
+  if (rounds > max_rounds) {
+    throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+  }
+  size_type half = block_size / 2;
+  size_type stride = trace_stride();
+  size_type count_s = sboxes.size();
+
+  parallel_for(count, 256, [&](size_type beg, size_type end) {
+    std::vector<size_type> io(2 * count_s);
+    for (size_type i = beg; i < end; ++i) {
+      bitstr permuted_input = bitstr(block_type(input[i]), block_size).permute(ip);
+      bitstr left = permuted_input.extract(0, half);
+      bitstr right = permuted_input.extract(half, block_size);
+      uint64_t* out = trace + i * rounds * stride;
+      for (size_type r = 0; r < rounds; ++r, out += stride) {
+        traced_round(key, left.blocks, right.blocks, r, io.data(), io.data() + count_s);
+        out[0] = left.value(0, half);
+        out[1] = right.value(0, half);
+        std::copy(io.begin(), io.end(), out + 2);
+        if (r < rounds - 1) std::swap(left, right);
+      }
+    }
+  });
+}
+
+// Keyed context
+feistel_ctx::feistel_ctx()
+{}
+
+feistel_ctx::feistel_ctx(std::shared_ptr<const feistel> cipher, const bitstr& key)
+{
+  if (!cipher) {
+    throw std::invalid_argument("Context needs a cipher.");
+  }
+  this->sched = cipher->expand_key(key);
+  this->cipher = std::move(cipher);
+}
+
+feistel_ctx::feistel_ctx(std::shared_ptr<const feistel> cipher, std::shared_ptr<const feistel::key_schedule> schedule)
+{
+  if (!cipher || !schedule) {
+    throw std::invalid_argument("Context needs a cipher and a key schedule.");
+  }
+  cipher->check_key(*schedule);
+  this->cipher = std::move(cipher);
+  this->sched = std::move(schedule);
+}
+
+// Round key for a given round
+const bitstr& feistel_ctx::round_key(size_type round) const
+{
+  if (round >= cipher->max_rounds) {
+    throw std::invalid_argument("Round exceeds maximum allowed.");
+  }
+  return sched->round_keys[round];
+}
+
+// Encryption/Decryption under the context's key
+bitstr feistel_ctx::encrypt(const bitstr& input, size_type rounds) const
+{
+  return cipher->encrypt(input, rounds, *sched);
+}
+
+bitstr feistel_ctx::decrypt(const bitstr& input, size_type rounds) const
+{
+  return cipher->decrypt(input, rounds, *sched);
+}
+
+void feistel_ctx::encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const
+{
+  cipher->encrypt_batch(input, output, count, rounds, *sched);
+}
+
+void feistel_ctx::decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const
+{
+  cipher->decrypt_batch(input, output, count, rounds, *sched);
+}
+
+void feistel_ctx::encrypt_trace(const bitstr& input, size_type rounds, std::vector<feistel::round_trace>& trace) const
+{
+  cipher->encrypt_trace(input, rounds, trace, *sched);
+}
+
+void feistel_ctx::encrypt_trace_batch(const uint64_t* input, uint64_t* trace, size_type count, size_type rounds) const
+{
+  cipher->encrypt_trace_batch(input, trace, count, rounds, *sched);
+}
@@ -21,7 +21,17 @@
  * ROUND KEYS:
  * The round key bits are assumed to be direct bits of the master 
  * key which are specified until the maximum number of rounds 
- * specified.
+ * specified, either as index tables or procedurally (see key_sched.h).
+ */
+
+/*
+ * KEYS:
+ * The cipher description (permutations, S-Boxes, round schedule and the
+ * tables built from them) never changes after construction. A key lives
+ * in a key_schedule made by expand_key; feistel_ctx pairs a shared,
+ * const cipher with one such schedule, so many keys can be used from
+ * many threads without copying the description. assign_key keeps a
+ * default key inside the cipher for single-key use.
  */
 
 /*
@@ -38,19 +48,77 @@
 #include "bitstr.h"
 #include "sbox.h"
 #include "perm.h"
+#include "key_sched.h"
 
 // Standard C++ Libraries
 #include <iostream>
 #include <cstdlib>
 #include <vector>
 #include <string>
+#include <memory>
+#include <cstdint>
 #include <stdexcept>
 
 // Class
 class feistel {
   private:
-    // Secret key
-    bitstr key;
+    // SP tables: S-Box input -> its bits after rf_after, as half-block words.
+    // Inputs are in gather order (bit t is input bit t of the S-Box, i.e.
+    // the bit reversal of its value); the entry of S-Box s for input u
+    // starts at (sp_offset[s] + u) * half_words.
+    size_type half_words;
+    size_type sp_entries;
+    std::vector<size_type> sp_offset;
+    std::vector<block_type> sp_tab;     // unkeyed, shared by every key
+
+    // S-Box input extractors compiled from rf_before: runs of adjacent half
+    // bits within one word (runs of S-Box s are sp_run_start[s] .. sp_run_start[s+1])
+    struct sp_run {
+      size_type word;
+      size_type shift;
+      size_type dst;
+      block_type mask;
+    };
+    std::vector<sp_run> sp_runs;
+    std::vector<size_type> sp_run_start;
+
+    // Build the tables
+    void build_sp();
+
+    // Gather-order input of S-Box s straight from the half block
+    size_type sbox_input(size_type s, const block_type* half) const;
+
+  public:
+    // Pre-expanded key: round keys and their S-Box slices (a few words per
+    // round; the key is XORed into the SP table index at encryption time)
+    struct key_schedule {
+      bitstr key;
+      std::vector<bitstr> round_keys;     // bits of key picked by round_sch
+      std::vector<size_type> sbox_keys;   // round key per round and S-Box, gather order
+    };
+
+    // State of one traced round
+    struct round_trace {
+      bitstr left;                        // halves after the round, before the swap
+      bitstr right;                       // (encrypt(input, r + 1) without fp)
+      std::vector<size_type> sbox_in;     // S-Box inputs with the round key added
+      std::vector<size_type> sbox_out;    // S-Box outputs
+    };
+
+  private:
+    // Current key (shared, so switching keys is a pointer swap)
+    std::shared_ptr<const key_schedule> sched;
+
+    // One round through the SP tables under a key: left ^= f(right)
+    void keyed_round(const key_schedule& key, block_type* left, const block_type* right, size_type round) const;
+
+    // Encryption/Decryption under a given key (null if none was assigned)
+    bitstr encrypt_under(const bitstr& input, size_type rounds, const key_schedule* key) const;
+    bitstr decrypt_under(const bitstr& input, size_type rounds, const key_schedule* key) const;
+
+    // One round that also records the S-Box inputs and outputs
+    void traced_round(const key_schedule& key, block_type* left, const block_type* right, size_type round,
+                      size_type* sbox_in, size_type* sbox_out) const;
 
   public:
     // Member Variables - Basics
@@ -69,8 +137,10 @@ class feistel {
     perm rf_before;
     perm rf_after;
 
-    // Member Variables - Round Keys
+    // Member Variables - Round Keys (index tables; for a procedural schedule
+    // they are derived from it, and keys are expanded through it)
     std::vector<std::vector<size_type>> round_sch;
+    std::shared_ptr<const rotating_schedule> key_proc;
 
     // Constructor
     feistel();
@@ -79,16 +149,86 @@ class feistel {
             const std::vector<sbox>& sboxes,
             const perm& rf_before, const perm& rf_after,
             const std::vector<std::vector<size_type>>& round_sch);
+    feistel(size_type block_size, size_type max_rounds, size_type key_size,
+            const perm& ip, const perm& op,
+            const std::vector<sbox>& sboxes,
+            const perm& rf_before, const perm& rf_after,
+            const rotating_schedule& schedule);
+
+    virtual ~feistel() = default;
+    feistel(const feistel&) = default;
+    feistel& operator=(const feistel&) = default;
+
+    // Shared copy of this cipher, keeping its type (specialised ciphers
+    // override the keyed encryption members, see feistel_static)
+    virtual std::shared_ptr<const feistel> share() const;
 
     // Assign Key
     void assign_key(const bitstr& key);
 
+    // Pre-expanded keys (expand once, then switch with use_key)
+    std::shared_ptr<const key_schedule> expand_key(const bitstr& key) const;
+    void use_key(std::shared_ptr<const key_schedule> schedule);
+    std::shared_ptr<const key_schedule> current_key() const;
+    const key_schedule& schedule() const;          // current key, throws if none
+    void check_key(const key_schedule& schedule) const;
+
+    // Hash of the description (not the key), stable across runs
+    uint64_t fingerprint() const;
+
+    // Round Key (bits of the assigned key picked by round_sch)
+    const bitstr& round_key(size_type round) const;
+
     // Round Function
     bitstr rfunc(const bitstr& input, const bitstr& round_key) const;
 
+    // Encryption/Decryption (assigned key, or an explicit one)
+    bitstr encrypt(const bitstr& input, size_type rounds) const;
+    bitstr decrypt(const bitstr& input, size_type rounds) const;
+    virtual bitstr encrypt(const bitstr& input, size_type rounds, const key_schedule& key) const;
+    virtual bitstr decrypt(const bitstr& input, size_type rounds, const key_schedule& key) const;
+
+    // Batch Encryption/Decryption of count packed blocks (block size at most 64,
+    // packed as by bitstr(value, block_size)); input and output may alias
+    void encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const;
+    void decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const;
+    virtual void encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds, const key_schedule& key) const;
+    virtual void decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds, const key_schedule& key) const;
+
+    // Traced Encryption: every round's state in one pass (trace is resized to rounds)
+    void encrypt_trace(const bitstr& input, size_type rounds, std::vector<round_trace>& trace) const;
+    void encrypt_trace(const bitstr& input, size_type rounds, std::vector<round_trace>& trace, const key_schedule& key) const;
+
+    // Batch Traced Encryption: trace_stride() words per block and round, laid out as
+    // left, right (packed as by bitstr(value, block_size / 2)), S-Box inputs, S-Box outputs;
+    // the round r record of block i starts at trace + (i * rounds + r) * trace_stride()
+    size_type trace_stride() const;
+    void encrypt_trace_batch(const uint64_t* input, uint64_t* trace, size_type count, size_type rounds) const;
+    void encrypt_trace_batch(const uint64_t* input, uint64_t* trace, size_type count, size_type rounds, const key_schedule& key) const;
+};
+
+// Per-key context: a shared cipher description and one expanded key.
+// Cheap to copy; give each thread or each key its own.
+class feistel_ctx {
+  public:
+    std::shared_ptr<const feistel> cipher;
+    std::shared_ptr<const feistel::key_schedule> sched;
+
+    // Constructors
+    feistel_ctx();
+    feistel_ctx(std::shared_ptr<const feistel> cipher, const bitstr& key);
+    feistel_ctx(std::shared_ptr<const feistel> cipher, std::shared_ptr<const feistel::key_schedule> schedule);
+
+    // Round Key
+    const bitstr& round_key(size_type round) const;
+
     // Encryption/Decryption
     bitstr encrypt(const bitstr& input, size_type rounds) const;
     bitstr decrypt(const bitstr& input, size_type rounds) const;
+    void encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const;
+    void decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const;
+    void encrypt_trace(const bitstr& input, size_type rounds, std::vector<feistel::round_trace>& trace) const;
+    void encrypt_trace_batch(const uint64_t* input, uint64_t* trace, size_type count, size_type rounds) const;
 };
 
 #endif
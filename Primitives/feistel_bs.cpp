@@ -0,0 +1,234 @@
+// Implementation of the bitsliced Feistel engine
+
+// Header Inclusion
+#include "feistel_bs.h"
+
+// Helpers
+// Transpose a 64 x 64 bit matrix in place: bit j of a[i] <-> bit i of a[j]
+static void transpose64(uint64_t a[64])
+{
+  uint64_t m = 0x00000000FFFFFFFFULL;
+  for (size_type j = 32; j != 0; j >>= 1, m ^= (m << j)) {
+    for (size_type k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+      uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+      a[k] ^= t << j;
+      a[k | j] ^= t;
+    }
+  }
+}
+
+// Inverse gather table of a permutation (empty if it has none)
+static std::vector<size_type> inverse_table(const perm& p)
+{
+  if (p.if_minv) return p.minv_table;
+  if (p.if_pinv) return p.pinv_table;
+  return {};
+}
+
+// Constructors
+template <size_type WORDS>
+feistel_bs<WORDS>::feistel_bs(const feistel& cipher) : feistel_bs(cipher, cipher.schedule())
+{}
+
+template <size_type WORDS>
+feistel_bs<WORDS>::feistel_bs(const feistel& cipher, const feistel::key_schedule& key)
+{
+  // Basics
+  if (cipher.block_size > 64) {
+    throw std::invalid_argument("Bitsliced engine needs a block size of at most 64.");
+  }
+  block_size = cipher.block_size;
+  half = block_size / 2;
+  max_rounds = cipher.max_rounds;
+
+  // Wires
+  ip_tab = cipher.ip.main_table;
+  fp_tab = cipher.fp.main_table;
+  ip_inv = inverse_table(cipher.ip);
+  fp_inv = inverse_table(cipher.fp);
+  before_tab = cipher.rf_before.main_table;
+  after_tab = cipher.rf_after.main_table;
+  expand_size = cipher.rf_before.op_size;
+  sub_size = cipher.rf_after.ip_size;
+
+  // S-Box circuits (ANF of every output bit by Mobius transform)
+  mono_size = 0;
+  size_type ip_start = 0;
+  size_type op_start = 0;
+  for (const auto& box : cipher.sboxes) {
+    bs_sbox circuit;
+    circuit.ip_start = ip_start;
+    circuit.op_start = op_start;
+    circuit.input_size = box.input_size;
+    circuit.output_size = box.output_size;
+    size_type size = size_type(1) << box.input_size;
+    for (size_type t = 0; t < box.output_size; ++t) {
+      std::vector<bool> anf(size);
+      for (size_type x = 0; x < size; ++x) {
+        anf[x] = (box[x] >> (box.output_size - 1 - t)) & 1;
+      }
+      for (size_type bit = 1; bit < size; bit <<= 1) {
+        for (size_type x = 0; x < size; ++x) {
+          if (x & bit) anf[x] = anf[x] ^ anf[x ^ bit];
+        }
+      }
+      std::vector<size_type> terms;
+      for (size_type u = 0; u < size; ++u) {
+        if (anf[u]) terms.push_back(u);
+      }
+      circuit.terms.push_back(terms);
+    }
+    circuits.push_back(circuit);
+    mono_size = std::max(mono_size, size);
+    ip_start += box.input_size;
+    op_start += box.output_size;
+  }
+
+  // Round keys
+  cipher.check_key(key);
+  for (size_type r = 0; r < max_rounds; ++r) {
+    const bitstr& round = key.round_keys[r];
+    if (round.bit_size != expand_size) {
+      throw std::invalid_argument("Round key must match size of permuted input.");
+    }
+    std::vector<bool> bits(expand_size);
+    for (size_type i = 0; i < expand_size; ++i) bits[i] = round[i];
+    round_keys.push_back(bits);
+  }
+}
+
+// Transpose LANES packed blocks into bit planes
+template <size_type WORDS>
+void feistel_bs<WORDS>::load(const uint64_t* input, std::vector<lane>& planes) const
+{
+  uint64_t rows[64];
+  for (size_type c = 0; c < WORDS; ++c) {
+    std::copy(input + c * 64, input + (c + 1) * 64, rows);
+    transpose64(rows);
+    for (size_type i = 0; i < block_size; ++i) {
+      planes[i][c] = rows[block_size - 1 - i];
+    }
+  }
+}
+
+// Transpose bit planes back into LANES packed blocks
+template <size_type WORDS>
+void feistel_bs<WORDS>::store(const std::vector<lane>& planes, uint64_t* output) const
+{
+  uint64_t rows[64];
+  for (size_type c = 0; c < WORDS; ++c) {
+    std::fill(rows, rows + 64, 0);
+    for (size_type i = 0; i < block_size; ++i) {
+      rows[block_size - 1 - i] = planes[i][c];
+    }
+    transpose64(rows);
+    std::copy(rows, rows + 64, output + c * 64);
+  }
+}
+
+// One round: left ^= f(right, round key r)
+template <size_type WORDS>
+void feistel_bs<WORDS>::round(lane* left, const lane* right, size_type r, lane* scratch) const
+{
+  lane zero = {};
+  lane ones = ~zero;
+  lane* expanded = scratch;
+  lane* subbed = scratch + expand_size;
+  lane* mono = subbed + sub_size;
+
+  // Expansion and round key
+  const std::vector<bool>& key = round_keys[r];
+  for (size_type j = 0; j < expand_size; ++j) {
+    expanded[j] = key[j] ? ~right[before_tab[j]] : right[before_tab[j]];
+  }
+
+  // S-Boxes: monomial m[u] is built from m[u minus its lowest bit]
+  for (const auto& circuit : circuits) {
+    size_type size = size_type(1) << circuit.input_size;
+    mono[0] = ones;
+    for (size_type u = 1; u < size; ++u) {
+      size_type low = __builtin_ctzl(u);
+      mono[u] = mono[u & (u - 1)] & expanded[circuit.ip_start + circuit.input_size - 1 - low];
+    }
+    for (size_type t = 0; t < circuit.output_size; ++t) {
+      lane acc = zero;
+      for (auto u : circuit.terms[t]) acc ^= mono[u];
+      subbed[circuit.op_start + t] = acc;
+    }
+  }
+
+  // Post S-Box permutation, XOR into the left half
+  for (size_type i = 0; i < half; ++i) {
+    left[i] ^= subbed[after_tab[i]];
+  }
+}
+
+// Encrypt LANES blocks
+template <size_type WORDS>
+void feistel_bs<WORDS>::encrypt(const uint64_t* input, uint64_t* output, size_type rounds) const
+{
+  if (rounds > max_rounds) {
+    throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+  }
+
+  // Initial permutation
+  std::vector<lane> planes(block_size);
+  std::vector<lane> state(block_size);
+  load(input, planes);
+  for (size_type i = 0; i < block_size; ++i) state[i] = planes[ip_tab[i]];
+  std::vector<lane> scratch(expand_size + sub_size + mono_size);
+
+  // Perform rounds (no swap on the last round)
+  lane* left = state.data();
+  lane* right = state.data() + half;
+  for (size_type r = 0; r < rounds; ++r) {
+    round(left, right, r, scratch.data());
+    if (r < rounds - 1) std::swap(left, right);
+  }
+
+  // Final permutation
+  for (size_type i = 0; i < block_size; ++i) {
+    size_type src = fp_tab[i];
+    planes[i] = (src < half) ? left[src] : right[src - half];
+  }
+  store(planes, output);
+}
+
+// Decrypt LANES blocks
+template <size_type WORDS>
+void feistel_bs<WORDS>::decrypt(const uint64_t* input, uint64_t* output, size_type rounds) const
+{
+  if (rounds > max_rounds) {
+    throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+  }
+  if (ip_inv.empty() || fp_inv.empty()) {
+    throw std::logic_error("Initial and final permutations must be invertible to decrypt.");
+  }
+
+  // Undo the final permutation
+  std::vector<lane> planes(block_size);
+  std::vector<lane> state(block_size);
+  load(input, planes);
+  for (size_type i = 0; i < block_size; ++i) state[i] = planes[fp_inv[i]];
+  std::vector<lane> scratch(expand_size + sub_size + mono_size);
+
+  // Perform rounds in reverse order (no swap on the first round)
+  lane* left = state.data();
+  lane* right = state.data() + half;
+  for (size_type r = rounds; r > 0; --r) {
+    round(left, right, r - 1, scratch.data());
+    if (r > 1) std::swap(left, right);
+  }
+
+  // Undo the initial permutation
+  for (size_type i = 0; i < block_size; ++i) {
+    size_type src = ip_inv[i];
+    planes[i] = (src < half) ? left[src] : right[src - half];
+  }
+  store(planes, output);
+}
+
+// Instantiations
+template class feistel_bs<1>;
+template class feistel_bs<4>;
+template class feistel_bs<8>;
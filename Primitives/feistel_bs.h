@@ -0,0 +1,115 @@
+// Bitsliced encryption engine for a keyed Feistel cipher, working on
+// 64 * WORDS blocks at a time
+
+/*
+ * LAYOUT:
+ * The state is kept transposed: lane word i holds bit i (bitstr order)
+ * of every block in the batch. Permutations and the expansion are plain
+ * index tables over lane words, round keys are folded in as all-ones or
+ * all-zero words, and every S-box output bit is evaluated as the XOR of
+ * its ANF monomials, which are built up with one AND each.
+ */
+
+/*
+ * LANES:
+ * A lane word is a GCC vector of WORDS 64-bit words, so feistel_bs64,
+ * feistel_bs256 and feistel_bs512 compile to scalar, AVX2 and AVX-512
+ * instructions when the target supports them (e.g. -mavx2, -mavx512f),
+ * and to plain 64-bit operations otherwise. feistel_bs_native (the
+ * engine of the batch APIs) is the widest one the build targets; the
+ * Makefile selects it with SIMD=avx2, SIMD=avx512 or SIMD=native.
+ */
+
+/*
+ * BLOCKS:
+ * Blocks are passed packed in uint64_t, in the integer convention of
+ * bitstr(value, size): bit 0 of the bitstr is the most significant of
+ * the block_size bits. The block size must be at most 64. The round keys
+ * are taken from the given schedule (or the cipher's assigned key) at
+ * construction time, so the engine has to be rebuilt for a new key.
+ */
+
+#ifndef FEISTEL_BS_H
+#define FEISTEL_BS_H
+
+// Custom Libraries
+#include "feistel.h"
+#include "bitstr.h"
+
+// Standard C++ Libraries
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+// Lane words (one bit position of 64 * WORDS blocks)
+template <size_type WORDS> struct bs_lane;
+template <> struct bs_lane<1> { typedef uint64_t type __attribute__((vector_size(8))); };
+template <> struct bs_lane<4> { typedef uint64_t type __attribute__((vector_size(32))); };
+template <> struct bs_lane<8> { typedef uint64_t type __attribute__((vector_size(64))); };
+
+// Class
+template <size_type WORDS>
+class feistel_bs {
+  public:
+    using lane = typename bs_lane<WORDS>::type;
+    static const size_type LANES = 64 * WORDS;
+
+    // Constructors
+    feistel_bs(const feistel& cipher);
+    feistel_bs(const feistel& cipher, const feistel::key_schedule& key);
+
+    // Encryption/Decryption of LANES packed blocks
+    void encrypt(const uint64_t* input, uint64_t* output, size_type rounds) const;
+    void decrypt(const uint64_t* input, uint64_t* output, size_type rounds) const;
+
+  private:
+    // S-Box as a circuit over its ANF
+    struct bs_sbox {
+      size_type ip_start;                       // first bit in the expanded half
+      size_type op_start;                       // first bit in the S-Box layer output
+      size_type input_size;
+      size_type output_size;
+      std::vector<std::vector<size_type>> terms;    // monomials of every output bit (bitstr order)
+    };
+
+    // Basics
+    size_type block_size;
+    size_type half;
+    size_type max_rounds;
+
+    // Wire tables (gathers: out[i] = in[table[i]])
+    std::vector<size_type> ip_tab;
+    std::vector<size_type> fp_tab;
+    std::vector<size_type> ip_inv;
+    std::vector<size_type> fp_inv;
+    std::vector<size_type> before_tab;
+    std::vector<size_type> after_tab;
+    size_type expand_size;
+    size_type sub_size;
+    size_type mono_size;
+
+    // S-Boxes and round keys
+    std::vector<bs_sbox> circuits;
+    std::vector<std::vector<bool>> round_keys;
+
+    // Helpers
+    void load(const uint64_t* input, std::vector<lane>& planes) const;
+    void store(const std::vector<lane>& planes, uint64_t* output) const;
+    void round(lane* left, const lane* right, size_type r, lane* scratch) const;
+};
+
+// Common widths
+using feistel_bs64 = feistel_bs<1>;
+using feistel_bs256 = feistel_bs<4>;
+using feistel_bs512 = feistel_bs<8>;
+
+// Widest engine the target supports
+#if defined(__AVX512F__)
+using feistel_bs_native = feistel_bs512;
+#elif defined(__AVX2__)
+using feistel_bs_native = feistel_bs256;
+#else
+using feistel_bs_native = feistel_bs64;
+#endif
+
+#endif
@@ -0,0 +1,378 @@
+// Implementation of the runtime code generation backend
+
+// Header Inclusion
+#include "feistel_jit.h"
+
+// System
+#include <dlfcn.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <cerrno>
+
+// Version of generate(): bump when the emitted code changes
+static const char* const JIT_VERSION = "feistel_jit 2";
+static const char* const JIT_FLAGS = "-O2 -shared -fPIC";
+
+// Helpers
+static std::string hex(uint64_t v)
+{
+  std::ostringstream ss;
+  ss << "0x" << std::hex << v << "ULL";
+  return ss.str();
+}
+
+// Inverse gather table of a permutation (empty if it has none)
+static std::vector<size_type> inverse_table(const perm& p)
+{
+  if (p.if_minv) return p.minv_table;
+  if (p.if_pinv) return p.pinv_table;
+  return {};
+}
+
+// Gather on packed integers: input bit table[i] (bitstr order, in bits) goes
+// to integer bit out_pos[i]. Emitted as one shift-and-mask term per bit
+// displacement, or as byte lookup tables when that takes fewer operations.
+static void emit_gather(std::ostream& os, const std::string& name, const std::vector<size_type>& table,
+                        size_type in, const std::vector<size_type>& out_pos)
+{
+  std::vector<std::pair<long, uint64_t>> terms;
+  for (size_type i = 0; i < table.size(); ++i) {
+    long delta = long(out_pos[i]) - long(in - 1 - table[i]);
+    uint64_t bit = uint64_t(1) << out_pos[i];
+    auto it = std::find_if(terms.begin(), terms.end(), [&](const auto& t) { return t.first == delta; });
+    if (it == terms.end()) terms.emplace_back(delta, bit);
+    else it->second |= bit;
+  }
+
+  // Three operations per term against two per byte lookup
+  size_type chunks = (in + 7) / 8;
+  if (3 * terms.size() <= 2 * chunks) {
+    os << "static inline uint64_t " << name << "(uint64_t x)\n{\n  return 0";
+    for (const auto& [delta, mask] : terms) {
+      if (delta >= 0) os << "\n    | ((x << " << delta << ") & " << hex(mask) << ")";
+      else os << "\n    | ((x >> " << -delta << ") & " << hex(mask) << ")";
+    }
+    os << ";\n}\n\n";
+    return;
+  }
+
+  // Entry [c][v]: output for input byte v at integer bits 8c .. 8c + 7
+  std::vector<uint64_t> tab(chunks * 256, 0);
+  for (size_type i = 0; i < table.size(); ++i) {
+    size_type b = in - 1 - table[i];
+    for (size_type v = 0; v < 256; ++v) {
+      if ((v >> (b % 8)) & 1) tab[(b / 8) * 256 + v] |= uint64_t(1) << out_pos[i];
+    }
+  }
+  os << "static const uint64_t " << name << "_T[" << chunks << "][256] = {";
+  for (size_type c = 0; c < chunks; ++c) {
+    os << "\n  {";
+    for (size_type v = 0; v < 256; ++v) os << (v % 4 == 0 ? "\n    " : " ") << hex(tab[c * 256 + v]) << ",";
+    os << "\n  },";
+  }
+  os << "\n};\n\n";
+  os << "static inline uint64_t " << name << "(uint64_t x)\n{\n  return 0";
+  for (size_type c = 0; c < chunks; ++c) {
+    os << "\n    | " << name << "_T[" << c << "][(x >> " << 8 * c << ") & 0xff]";
+  }
+  os << ";\n}\n\n";
+}
+
+// Output positions of a block-sized gather in the packed convention
+static std::vector<size_type> msb_first(size_type size)
+{
+  std::vector<size_type> pos(size);
+  for (size_type i = 0; i < size; ++i) pos[i] = size - 1 - i;
+  return pos;
+}
+
+// Unrolled rounds: the halves alternate roles instead of being swapped
+static void emit_rounds(std::ostream& os, size_type rounds, bool reverse)
+{
+  for (size_type j = 0; j < rounds; ++j) {
+    size_type r = reverse ? rounds - 1 - j : j;
+    if (j % 2 == 0) os << "    a ^= f(b, keys[" << r << "]);\n";
+    else os << "    b ^= f(a, keys[" << r << "]);\n";
+  }
+}
+
+// Source for a cipher and round count
+std::string feistel_jit::generate(const feistel& cipher, size_type rounds)
+{
+  size_type n = cipher.block_size;
+  size_type half = n / 2;
+  if (n > 64 || cipher.rf_before.op_size > 64 || rounds > cipher.max_rounds) return "";
+  std::vector<size_type> ip_inv = inverse_table(cipher.ip);
+  std::vector<size_type> fp_inv = inverse_table(cipher.fp);
+
+  std::ostringstream os;
+  os << "// Generated for Feistel cipher " << hex(cipher.fingerprint()) << ", " << rounds << " rounds\n\n";
+  os << "#include <stdint.h>\n#include <stddef.h>\n\n";
+
+  // SP tables: S-Box s on gather-order input u, through rf_after, as a packed half
+  size_type op_start = 0;
+  for (size_type s = 0; s < cipher.sboxes.size(); ++s) {
+    const sbox& box = cipher.sboxes[s];
+    os << "static const uint64_t SP" << s << "[" << (size_type(1) << box.input_size) << "] = {";
+    for (size_type u = 0; u < (size_type(1) << box.input_size); ++u) {
+      size_type x = 0;
+      for (size_type t = 0; t < box.input_size; ++t) x |= ((u >> t) & 1) << (box.input_size - 1 - t);
+      size_type y = box[x];
+      uint64_t entry = 0;
+      for (size_type i = 0; i < half; ++i) {
+        size_type src = cipher.rf_after.main_table[i];
+        if (src >= op_start && src < op_start + box.output_size) {
+          entry |= uint64_t((y >> (box.output_size - 1 - (src - op_start))) & 1) << (half - 1 - i);
+        }
+      }
+      os << (u % 4 == 0 ? "\n  " : " ") << hex(entry) << ",";
+    }
+    os << "\n};\n\n";
+    op_start += box.output_size;
+  }
+
+  // Permutations and the expansion (S-Box inputs packed in gather order)
+  emit_gather(os, "ip", cipher.ip.main_table, n, msb_first(n));
+  emit_gather(os, "fp", cipher.fp.main_table, n, msb_first(n));
+  if (!ip_inv.empty() && !fp_inv.empty()) {
+    emit_gather(os, "ip_inv", ip_inv, n, msb_first(n));
+    emit_gather(os, "fp_inv", fp_inv, n, msb_first(n));
+  }
+  std::vector<size_type> expand_pos(cipher.rf_before.op_size);
+  for (size_type j = 0; j < expand_pos.size(); ++j) expand_pos[j] = j;
+  emit_gather(os, "expand", cipher.rf_before.main_table, half, expand_pos);
+
+  // Round function
+  os << "static inline uint64_t f(uint64_t r, uint64_t k)\n{\n  uint64_t u = expand(r) ^ k;\n  return 0";
+  size_type ip_start = 0;
+  for (size_type s = 0; s < cipher.sboxes.size(); ++s) {
+    size_type in = cipher.sboxes[s].input_size;
+    os << "\n    ^ SP" << s << "[(u >> " << ip_start << ") & " << hex((uint64_t(1) << in) - 1) << "]";
+    ip_start += in;
+  }
+  os << ";\n}\n\n";
+
+  // Entry points (left is a after an even number of rounds, b otherwise)
+  const char* out = (rounds == 0 || (rounds - 1) % 2 == 0) ? "(a << " : "(b << ";
+  const char* rest = (rounds == 0 || (rounds - 1) % 2 == 0) ? ") | b" : ") | a";
+  os << "extern \"C\" void feistel_jit_encrypt(const uint64_t* input, uint64_t* output, size_t count, const uint64_t* keys)\n{\n";
+  os << "  for (size_t i = 0; i < count; ++i) {\n";
+  os << "    uint64_t s = ip(input[i]);\n";
+  os << "    uint64_t a = s >> " << half << ";\n    uint64_t b = s & " << hex((uint64_t(1) << half) - 1) << ";\n";
+  emit_rounds(os, rounds, false);
+  os << "    output[i] = fp(" << out << half << rest << ");\n  }\n}\n";
+  if (!ip_inv.empty() && !fp_inv.empty()) {
+    os << "\nextern \"C\" void feistel_jit_decrypt(const uint64_t* input, uint64_t* output, size_t count, const uint64_t* keys)\n{\n";
+    os << "  for (size_t i = 0; i < count; ++i) {\n";
+    os << "    uint64_t s = fp_inv(input[i]);\n";
+    os << "    uint64_t a = s >> " << half << ";\n    uint64_t b = s & " << hex((uint64_t(1) << half) - 1) << ";\n";
+    emit_rounds(os, rounds, true);
+    os << "    output[i] = ip_inv(" << out << half << rest << ");\n  }\n}\n";
+  }
+  return os.str();
+}
+
+// Constructors
+feistel_jit::feistel_jit(std::shared_ptr<const feistel> cipher, size_type rounds,
+                         const std::string& cache_dir, const std::string& compiler)
+  : cipher(std::move(cipher)), rounds(rounds), cache_dir(cache_dir), compiler(compiler),
+    handle(nullptr), enc(nullptr), dec(nullptr)
+{
+  if (!this->cipher) {
+    throw std::invalid_argument("Backend needs a cipher.");
+  }
+  if (rounds > this->cipher->max_rounds) {
+    throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+  }
+  if (this->cache_dir.empty()) this->cache_dir = default_cache_dir();
+  load();
+}
+
+feistel_jit::feistel_jit(const feistel& cipher, size_type rounds,
+                         const std::string& cache_dir, const std::string& compiler)
+  : feistel_jit(cipher.share(), rounds, cache_dir, compiler)
+{}
+
+feistel_jit::~feistel_jit()
+{
+  if (handle) dlclose(handle);
+}
+
+// Per-user cache: $XDG_CACHE_HOME/linsuite_jit, else ~/.cache/linsuite_jit
+// (empty if there is no home directory, which disables the backend)
+std::string feistel_jit::default_cache_dir()
+{
+  const char* xdg = std::getenv("XDG_CACHE_HOME");
+  if (xdg && xdg[0] == '/') return (std::filesystem::path(xdg) / "linsuite_jit").string();
+  const char* home = std::getenv("HOME");
+  if (!home || home[0] != '/') {
+    const passwd* pw = getpwuid(getuid());
+    home = pw ? pw->pw_dir : nullptr;
+  }
+  if (!home || home[0] != '/') return "";
+  return (std::filesystem::path(home) / ".cache" / "linsuite_jit").string();
+}
+
+// Owned by this user and not writable by anyone else
+static bool private_path(const std::string& path)
+{
+  struct stat st;
+  return lstat(path.c_str(), &st) == 0 && st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+// Run the compiler on src without a shell: the compiler string and the
+// flags are split at whitespace into argv, paths are passed as they are
+static bool run_compiler(const std::string& compiler, const std::string& out, const std::string& src)
+{
+  std::vector<std::string> args;
+  std::istringstream words(compiler + " " + JIT_FLAGS);
+  for (std::string word; words >> word; ) args.push_back(word);
+  if (args.empty()) return false;
+  args.push_back("-o");
+  args.push_back(out);
+  args.push_back(src);
+
+  std::vector<char*> argv;
+  for (std::string& arg : args) argv.push_back(arg.data());
+  argv.push_back(nullptr);
+
+  pid_t pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0) {
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) return false;
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Find or build the object and resolve the entry points
+void feistel_jit::load()
+{
+  std::string source = generate(*cipher, rounds);
+  if (source.empty() || cache_dir.empty()) return;
+
+  // The cache directory must be ours and closed to others (created 0700)
+  std::error_code ec;
+  if (!std::filesystem::exists(cache_dir, ec)) {
+    std::filesystem::path parent = std::filesystem::path(cache_dir).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+    if (mkdir(cache_dir.c_str(), 0700) != 0 && errno != EEXIST) return;
+  }
+  if (!std::filesystem::is_directory(cache_dir, ec) || !private_path(cache_dir)) {
+    std::cerr << "feistel_jit: cache directory " << cache_dir << " is not private, using the generic path." << std::endl;
+    return;
+  }
+
+  // Objects are named by cipher, rounds and a hash of everything that
+  // goes into them: generator version, compiler, flags and the source
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (const std::string& part : {std::string(JIT_VERSION), compiler, std::string(JIT_FLAGS), source}) {
+    for (unsigned char c : part) {
+      h ^= c;
+      h *= 0x100000001b3ULL;
+    }
+    h ^= 0xff;
+    h *= 0x100000001b3ULL;
+  }
+  std::ostringstream name;
+  name << "feistel_" << std::hex << cipher->fingerprint() << "_r" << std::dec << rounds << "_" << std::hex << h;
+  std::filesystem::path base = std::filesystem::path(cache_dir) / name.str();
+  std::string so = base.string() + ".so";
+
+  // Compile on a miss (to private names first, so concurrent builds do not clash)
+  if (!std::filesystem::exists(so, ec)) {
+    std::string tag = "." + std::to_string(getpid());
+    std::string src = base.string() + tag + ".cpp";
+    std::string tmp = base.string() + tag + ".so";
+    {
+      std::ofstream file(src);
+      if (!(file << source)) {
+        std::filesystem::remove(src, ec);
+        return;
+      }
+    }
+    // Compiler diagnostics go to stderr
+    bool built = run_compiler(compiler, tmp, src);
+    std::filesystem::remove(src, ec);
+    if (built) std::filesystem::rename(tmp, so, ec);
+    if (!built || ec) {
+      std::filesystem::remove(tmp, ec);
+      if (!built) std::cerr << "feistel_jit: compiling with '" << compiler << "' failed, using the generic path." << std::endl;
+      return;
+    }
+  }
+
+  // Never load an object someone else could have written
+  if (!private_path(so)) {
+    std::cerr << "feistel_jit: " << so << " is not private, using the generic path." << std::endl;
+    return;
+  }
+  handle = dlopen(so.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!handle) return;
+  enc = reinterpret_cast<batch_fn>(dlsym(handle, "feistel_jit_encrypt"));
+  dec = reinterpret_cast<batch_fn>(dlsym(handle, "feistel_jit_decrypt"));
+}
+
+// Backend in use
+bool feistel_jit::compiled() const
+{
+  return enc != nullptr;
+}
+
+// Round keys as packed S-Box inputs (S-Box s at the sum of the previous input sizes)
+std::vector<uint64_t> feistel_jit::pack_keys(const feistel::key_schedule& key) const
+{
+  size_type count = cipher->sboxes.size();
+  std::vector<uint64_t> result(rounds, 0);
+  for (size_type r = 0; r < rounds; ++r) {
+    size_type start = 0;
+    for (size_type s = 0; s < count; ++s) {
+      result[r] |= uint64_t(key.sbox_keys[r * count + s]) << start;
+      start += cipher->sboxes[s].input_size;
+    }
+  }
+  return result;
+}
+
+// Generated code over chunks in parallel, or the generic batch path
+void feistel_jit::run(batch_fn fn, bool decrypt, const uint64_t* input, uint64_t* output, size_type count,
+                      const feistel::key_schedule& key) const
+{
+  if (!fn) {
+    if (decrypt) cipher->decrypt_batch(input, output, count, rounds, key);
+    else cipher->encrypt_batch(input, output, count, rounds, key);
+    return;
+  }
+  cipher->check_key(key);
+  std::vector<uint64_t> keys = pack_keys(key);
+  parallel_for(count, 1 << 14, [&](size_type beg, size_type end) {
+    fn(input + beg, output + beg, end - beg, keys.data());
+  });
+}
+
+// Batch Encryption/Decryption
+void feistel_jit::encrypt_batch(const uint64_t* input, uint64_t* output, size_type count) const
+{
+  run(enc, false, input, output, count, cipher->schedule());
+}
+
+void feistel_jit::decrypt_batch(const uint64_t* input, uint64_t* output, size_type count) const
+{
+  run(dec, true, input, output, count, cipher->schedule());
+}
+
+void feistel_jit::encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, const feistel::key_schedule& key) const
+{
+  run(enc, false, input, output, count, key);
+}
+
+void feistel_jit::decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, const feistel::key_schedule& key) const
+{
+  run(dec, true, input, output, count, key);
+}
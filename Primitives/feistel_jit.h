@@ -0,0 +1,99 @@
+// Runtime code generation backend: straight-line C++ for one Feistel
+// cipher and round count, compiled with the local compiler and loaded
+// as a shared object
+
+/*
+ * GENERATED CODE:
+ * The permutations and rf_before become shift-and-mask sequences (one
+ * term per distinct bit displacement) or, when those get long, inlined
+ * byte lookup tables; S-Boxes with rf_after become inlined SP tables,
+ * and all rounds are unrolled. Round keys are passed at run time as
+ * packed S-Box inputs, so one object serves every key.
+ * Blocks are packed as in encrypt_batch; the block size and the total
+ * S-Box input size must both be at most 64.
+ */
+
+/*
+ * CACHE:
+ * Objects are kept in a per-user cache directory ($XDG_CACHE_HOME or
+ * ~/.cache, linsuite_jit), created 0700; the directory and any object
+ * must be owned by the user and closed to writes by others, or nothing
+ * is loaded. Objects are named by the cipher fingerprint, the round
+ * count and a hash of the generator version, compiler, flags and source,
+ * so an existing object is only reused when it is exactly what would be
+ * built. The compiler runs without a shell: the compiler string is
+ * split at whitespace (so "ccache g++" works) and every path is passed
+ * as one argument. Compiler errors go to stderr. If generation,
+ * compilation or loading fails (or the cipher is out of range), the
+ * batch calls fall back to feistel's own batch path; compiled() tells
+ * which one is in use.
+ */
+
+#ifndef FEISTEL_JIT_H
+#define FEISTEL_JIT_H
+
+// Custom Libraries
+#include "feistel.h"
+#include "parallel.h"
+
+// Standard C++ Libraries
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <filesystem>
+
+// Class
+class feistel_jit {
+  public:
+    // Generated entry point: count blocks with one packed round key per round
+    using batch_fn = void (*)(const uint64_t* input, uint64_t* output, size_t count, const uint64_t* keys);
+
+    std::shared_ptr<const feistel> cipher;
+    size_type rounds;
+    std::string cache_dir;
+    std::string compiler;
+
+    // Constructors (generate, compile and load, or fall back)
+    feistel_jit(std::shared_ptr<const feistel> cipher, size_type rounds,
+                const std::string& cache_dir = "", const std::string& compiler = "c++");
+    feistel_jit(const feistel& cipher, size_type rounds,
+                const std::string& cache_dir = "", const std::string& compiler = "c++");
+    ~feistel_jit();
+
+    feistel_jit(const feistel_jit&) = delete;
+    feistel_jit& operator=(const feistel_jit&) = delete;
+
+    // Backend in use
+    bool compiled() const;
+
+    // Batch Encryption/Decryption (assigned key, or an explicit one)
+    void encrypt_batch(const uint64_t* input, uint64_t* output, size_type count) const;
+    void decrypt_batch(const uint64_t* input, uint64_t* output, size_type count) const;
+    void encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, const feistel::key_schedule& key) const;
+    void decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, const feistel::key_schedule& key) const;
+
+    // Source for a cipher and round count (empty if out of range)
+    static std::string generate(const feistel& cipher, size_type rounds);
+
+    // Default cache directory (empty if the user has no home directory)
+    static std::string default_cache_dir();
+
+  private:
+    void* handle;
+    batch_fn enc;
+    batch_fn dec;
+
+    // Helpers
+    void load();
+    std::vector<uint64_t> pack_keys(const feistel::key_schedule& key) const;
+    void run(batch_fn fn, bool decrypt, const uint64_t* input, uint64_t* output, size_type count,
+             const feistel::key_schedule& key) const;
+};
+
+#endif
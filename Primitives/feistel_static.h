@@ -0,0 +1,284 @@
+// Feistel cipher specialised at compile time from a constexpr
+// specification of a fixed cipher
+
+/*
+ * SPECIFICATION:
+ * Spec is a struct of static constexpr members in the conventions of
+ * feistel (gather tables on bitstr indices, S-Box tables indexed by the
+ * integer input value):
+ *   block_size, key_size, rounds                 block of at most 64 bits
+ *   sbox_count, sbox_in, sbox_out                S-Boxes of a single size
+ *   std::array ip, fp                            block_size entries each
+ *   std::array rf_before                         sbox_count * sbox_in entries
+ *   std::array rf_after                          block_size / 2 entries
+ *   std::array<std::array<...>, sbox_count> sboxes
+ *   std::array<std::array<...>, rounds> round_sch
+ */
+
+/*
+ * SPECIALISATION:
+ * All tables are computed at compile time: the block permutations and
+ * rf_before become byte tables on packed integers (one lookup per input
+ * byte, fully unrolled), and the S-Boxes with rf_after become SP tables.
+ * The S-Box inputs of a round sit in one word, so the round key is one
+ * XOR. Only the round keys are read at run time, from the key schedule
+ * of the underlying feistel. All S-Box inputs together must fit in 64
+ * bits.
+ */
+
+/*
+ * INTERFACE:
+ * feistel_static<Spec> is a feistel built from the same specification, so
+ * attack, trail and the other analyses take it as one. The keyed
+ * encryption members override feistel's virtual ones, so calls through a
+ * feistel reference or a feistel_ctx (attack, codebook) take the
+ * specialised path too; share() keeps the type when a consumer copies
+ * the cipher. Only a plain copy into a feistel value falls back to the
+ * generic path.
+ */
+
+#ifndef FEISTEL_STATIC_H
+#define FEISTEL_STATIC_H
+
+// Custom Libraries
+#include "feistel.h"
+#include "parallel.h"
+
+// Standard C++ Libraries
+#include <array>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <stdexcept>
+
+// Compile-time helpers
+// Inverse of a block permutation (gather table)
+template <size_type N>
+constexpr std::array<size_type, N> static_invert(const std::array<size_type, N>& table)
+{
+  std::array<size_type, N> result{};
+  std::array<bool, N> seen{};
+  for (size_type i = 0; i < N; ++i) {
+    if (table[i] >= N || seen[table[i]]) throw std::logic_error("Block permutation is not invertible.");
+    seen[table[i]] = true;
+    result[table[i]] = i;
+  }
+  return result;
+}
+
+// SP tables: S-Box s on gather-order input u, through rf_after, as a packed half
+template <typename Spec>
+constexpr auto static_sp_tables()
+{
+  constexpr size_type H = Spec::block_size / 2;
+  constexpr size_type SIN = Spec::sbox_in;
+  constexpr size_type SOUT = Spec::sbox_out;
+  std::array<std::array<uint64_t, (size_type(1) << SIN)>, Spec::sbox_count> result{};
+  for (size_type s = 0; s < Spec::sbox_count; ++s) {
+    for (size_type u = 0; u < (size_type(1) << SIN); ++u) {
+      size_type x = 0;
+      for (size_type t = 0; t < SIN; ++t) x |= ((u >> t) & 1) << (SIN - 1 - t);
+      size_type y = Spec::sboxes[s][x];
+      uint64_t entry = 0;
+      for (size_type i = 0; i < H; ++i) {
+        size_type src = Spec::rf_after[i];
+        if (src / SOUT == s) entry |= uint64_t((y >> (SOUT - 1 - src % SOUT)) & 1) << (H - 1 - i);
+      }
+      result[s][u] = entry;
+    }
+  }
+  return result;
+}
+
+// Byte tables for a gather on packed integers (out[i] = in[table[i]]): entry
+// [c][v] is the output for input byte v at integer bits 8c .. 8c + 7. Output
+// bit i goes to integer bit OUT - 1 - i (msb_first) or to bit i.
+template <size_type IN, size_type OUT>
+constexpr std::array<std::array<uint64_t, 256>, (IN + 7) / 8> static_byte_tables(const std::array<size_type, OUT>& table, bool msb_first)
+{
+  std::array<std::array<uint64_t, 256>, (IN + 7) / 8> result{};
+  for (size_type i = 0; i < OUT; ++i) {
+    size_type b = IN - 1 - table[i];
+    uint64_t bit = uint64_t(1) << (msb_first ? OUT - 1 - i : i);
+    for (size_type v = 0; v < 256; ++v) {
+      if ((v >> (b % 8)) & 1) result[b / 8][v] |= bit;
+    }
+  }
+  return result;
+}
+
+// Class
+template <typename Spec>
+class feistel_static : public feistel {
+  public:
+    static constexpr size_type N = Spec::block_size;
+    static constexpr size_type H = N / 2;
+    static constexpr size_type SBOXES = Spec::sbox_count;
+    static constexpr size_type SIN = Spec::sbox_in;
+    static constexpr size_type SOUT = Spec::sbox_out;
+
+    static_assert(N % 2 == 0 && N <= 64, "Static Feistel needs an even block size of at most 64.");
+    static_assert(Spec::ip.size() == N && Spec::fp.size() == N, "Initial and final permutations must match the block size.");
+    static_assert(Spec::rf_before.size() == SBOXES * SIN, "rf_before must feed every S-Box input.");
+    static_assert(SBOXES * SIN <= 64, "S-Box inputs must fit in 64 bits.");
+    static_assert(Spec::rf_after.size() == H, "rf_after must produce half a block.");
+    static_assert(Spec::sboxes.size() == SBOXES && Spec::round_sch.size() == Spec::rounds, "S-Box and round tables must match their counts.");
+
+    // Constructor
+    feistel_static() : feistel(describe())
+    {}
+
+    // Shared copy that keeps the specialised path
+    std::shared_ptr<const feistel> share() const override
+    {
+      return std::make_shared<const feistel_static>(*this);
+    }
+
+    // Encryption/Decryption (assigned key, or an explicit one)
+    bitstr encrypt(const bitstr& input, size_type rounds) const
+    {
+      return encrypt(input, rounds, schedule());
+    }
+
+    bitstr decrypt(const bitstr& input, size_type rounds) const
+    {
+      return decrypt(input, rounds, schedule());
+    }
+
+    bitstr encrypt(const bitstr& input, size_type rounds, const key_schedule& key) const override
+    {
+      check_args(input.bit_size, rounds, key);
+      return bitstr(block_type(encrypt_block(input.value(0, N), rounds, pack_keys(key).data())), N);
+    }
+
+    bitstr decrypt(const bitstr& input, size_type rounds, const key_schedule& key) const override
+    {
+      check_args(input.bit_size, rounds, key);
+      return bitstr(block_type(decrypt_block(input.value(0, N), rounds, pack_keys(key).data())), N);
+    }
+
+    // Batch Encryption/Decryption of count packed blocks
+    void encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const
+    {
+      encrypt_batch(input, output, count, rounds, schedule());
+    }
+
+    void decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds) const
+    {
+      decrypt_batch(input, output, count, rounds, schedule());
+    }
+
+    void encrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds, const key_schedule& key) const override
+    {
+      check_args(N, rounds, key);
+      std::array<uint64_t, Spec::rounds> keys = pack_keys(key);
+      parallel_for(count, 1 << 14, [&](size_type beg, size_type end) {
+        for (size_type i = beg; i < end; ++i) output[i] = encrypt_block(input[i], rounds, keys.data());
+      });
+    }
+
+    void decrypt_batch(const uint64_t* input, uint64_t* output, size_type count, size_type rounds, const key_schedule& key) const override
+    {
+      check_args(N, rounds, key);
+      std::array<uint64_t, Spec::rounds> keys = pack_keys(key);
+      parallel_for(count, 1 << 14, [&](size_type beg, size_type end) {
+        for (size_type i = beg; i < end; ++i) output[i] = decrypt_block(input[i], rounds, keys.data());
+      });
+    }
+
+    // Round keys of a schedule as packed S-Box inputs (S-Box s at bits s * sbox_in)
+    static std::array<uint64_t, Spec::rounds> pack_keys(const key_schedule& key)
+    {
+      std::array<uint64_t, Spec::rounds> result{};
+      for (size_type r = 0; r < Spec::rounds; ++r) {
+        for (size_type s = 0; s < SBOXES; ++s) {
+          result[r] |= uint64_t(key.sbox_keys[r * SBOXES + s]) << (s * SIN);
+        }
+      }
+      return result;
+    }
+
+    // Single packed block with packed round keys (no checks)
+    static uint64_t encrypt_block(uint64_t block, size_type rounds, const uint64_t* keys)
+    {
+      uint64_t state = lookup(IP_TAB, block, std::make_index_sequence<IP_TAB.size()>());
+      uint64_t left = state >> H;
+      uint64_t right = state & HALF_MASK;
+      for (size_type r = 0; r < rounds; ++r) {
+        left ^= round_fn(right, keys[r], std::make_index_sequence<SBOXES>());
+        if (r < rounds - 1) std::swap(left, right);
+      }
+      return lookup(FP_TAB, (left << H) | right, std::make_index_sequence<FP_TAB.size()>());
+    }
+
+    static uint64_t decrypt_block(uint64_t block, size_type rounds, const uint64_t* keys)
+    {
+      uint64_t state = lookup(FP_INV_TAB, block, std::make_index_sequence<FP_INV_TAB.size()>());
+      uint64_t left = state >> H;
+      uint64_t right = state & HALF_MASK;
+      for (size_type r = rounds; r > 0; --r) {
+        left ^= round_fn(right, keys[r - 1], std::make_index_sequence<SBOXES>());
+        if (r > 1) std::swap(left, right);
+      }
+      return lookup(IP_INV_TAB, (left << H) | right, std::make_index_sequence<IP_INV_TAB.size()>());
+    }
+
+  private:
+    static constexpr uint64_t HALF_MASK = (uint64_t(1) << H) - 1;
+
+    static constexpr uint64_t SBOX_MASK = (uint64_t(1) << SIN) - 1;
+
+    // Permutations and the expansion as byte tables, the rest as SP tables
+    static constexpr auto IP_TAB = static_byte_tables<N, N>(Spec::ip, true);
+    static constexpr auto FP_TAB = static_byte_tables<N, N>(Spec::fp, true);
+    static constexpr auto IP_INV_TAB = static_byte_tables<N, N>(static_invert<N>(Spec::ip), true);
+    static constexpr auto FP_INV_TAB = static_byte_tables<N, N>(static_invert<N>(Spec::fp), true);
+    static constexpr auto EXPAND_TAB = static_byte_tables<H, SBOXES * SIN>(Spec::rf_before, false);
+    static constexpr auto SP = static_sp_tables<Spec>();
+
+    // Unrolled byte-table gather
+    template <typename Tables, size_type... C>
+    static inline uint64_t lookup(const Tables& tab, uint64_t x, std::index_sequence<C...>)
+    {
+      return (uint64_t(0) | ... | tab[C][(x >> (8 * C)) & 0xff]);
+    }
+
+    // Round function with the packed round key of one round
+    template <size_type... S>
+    static inline uint64_t round_fn(uint64_t right, uint64_t key, std::index_sequence<S...>)
+    {
+      uint64_t u = lookup(EXPAND_TAB, right, std::make_index_sequence<EXPAND_TAB.size()>()) ^ key;
+      return (uint64_t(0) ^ ... ^ SP[S][(u >> (S * SIN)) & SBOX_MASK]);
+    }
+
+    // Argument checks shared by the public entry points
+    void check_args(size_type size, size_type rounds, const key_schedule& key) const
+    {
+      if (size != N) {
+        throw std::invalid_argument("Input size must match the block size.");
+      }
+      if (rounds > Spec::rounds) {
+        throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+      }
+      check_key(key);
+    }
+
+    // The runtime description of the same cipher
+    static feistel describe()
+    {
+      auto to_vector = [](const auto& table) { return std::vector<size_type>(table.begin(), table.end()); };
+      std::vector<sbox> boxes;
+      for (size_type s = 0; s < SBOXES; ++s) {
+        std::vector<size_type> table = to_vector(Spec::sboxes[s]);
+        boxes.push_back(sbox(SIN, SOUT, table.data()));
+      }
+      std::vector<std::vector<size_type>> sch;
+      for (const auto& round : Spec::round_sch) sch.push_back(to_vector(round));
+      return feistel(N, Spec::rounds, Spec::key_size,
+                     perm(N, N, to_vector(Spec::ip)), perm(N, N, to_vector(Spec::fp)), boxes,
+                     perm(H, SBOXES * SIN, to_vector(Spec::rf_before)), perm(SBOXES * SOUT, H, to_vector(Spec::rf_after)),
+                     sch);
+    }
+};
+
+#endif
@@ -0,0 +1,145 @@
+// Implementation of procedural key schedules
+
+// Header Inclusion
+#include "key_sched.h"
+
+// Helpers
+// Byte tables of a gather on packed integers: entry c * 256 + v is the output
+// for input byte v at integer bits 8c .. 8c + 7
+static std::vector<uint64_t> byte_tables(const perm& p)
+{
+  size_type chunks = (p.ip_size + 7) / 8;
+  std::vector<uint64_t> tab(chunks * 256, 0);
+  for (size_type i = 0; i < p.op_size; ++i) {
+    size_type b = p.ip_size - 1 - p.main_table[i];
+    for (size_type v = 0; v < 256; ++v) {
+      if ((v >> (b % 8)) & 1) tab[(b / 8) * 256 + v] |= uint64_t(1) << (p.op_size - 1 - i);
+    }
+  }
+  return tab;
+}
+
+static inline uint64_t lookup(const std::vector<uint64_t>& tab, uint64_t x)
+{
+  uint64_t result = 0;
+  for (size_type c = 0; c < tab.size() / 256; ++c) result |= tab[c * 256 + ((x >> (8 * c)) & 0xff)];
+  return result;
+}
+
+// Constructor
+rotating_schedule::rotating_schedule(const perm& pc1, size_type registers, const std::vector<size_type>& rotations, const perm& pc2)
+{
+  if (registers == 0 || pc1.op_size % registers != 0) {
+    throw std::invalid_argument("Register must split into equal parts.");
+  }
+  if (pc2.ip_size != pc1.op_size) {
+    throw std::invalid_argument("Round key selection must read the whole register.");
+  }
+  this->pc1 = pc1;
+  this->registers = registers;
+  this->rotations = rotations;
+  this->pc2 = pc2;
+  if (pc1.ip_size <= 64 && pc1.op_size <= 64 && pc2.op_size <= 64) {
+    pc1_tab = byte_tables(pc1);
+    pc2_tab = byte_tables(pc2);
+  }
+}
+
+// Sizes
+size_type rotating_schedule::key_size() const
+{
+  return pc1.ip_size;
+}
+
+size_type rotating_schedule::rounds() const
+{
+  return rotations.size();
+}
+
+size_type rotating_schedule::round_key_size() const
+{
+  return pc2.op_size;
+}
+
+// Round keys of a key
+std::vector<bitstr> rotating_schedule::expand(const bitstr& key) const
+{
+  if (key.bit_size != key_size()) {
+    throw std::invalid_argument("Key size does not match the schedule's key size.");
+  }
+  std::vector<bitstr> result;
+  result.reserve(rounds());
+  if (packed()) {
+    std::vector<uint64_t> keys(rounds());
+    expand_packed(key.value(0, key.bit_size), keys.data());
+    for (auto k : keys) result.emplace_back(block_type(k), round_key_size());
+    return result;
+  }
+
+  // Generic path: rotations on bitstr words
+  size_type part = pc1.op_size / registers;
+  bitstr reg = key.permute(pc1);
+  std::vector<bitstr> parts;
+  for (size_type p = 0; p < registers; ++p) parts.push_back(reg.extract(p * part, (p + 1) * part));
+  for (size_type r = 0; r < rounds(); ++r) {
+    bitstr joined;
+    for (size_type p = 0; p < registers; ++p) {
+      parts[p] = parts[p].rotl(rotations[r]);
+      if (p == 0) joined = parts[p];
+      else joined += parts[p];
+    }
+    result.push_back(joined.permute(pc2));
+  }
+  return result;
+}
+
+// Packed expansion
+bool rotating_schedule::packed() const
+{
+  return !pc1_tab.empty();
+}
+
+void rotating_schedule::expand_packed(uint64_t key, uint64_t* round_keys) const
+{
+  size_type size = pc1.op_size;
+  size_type part = size / registers;
+  uint64_t mask = (part == 64) ? ~uint64_t(0) : ((uint64_t(1) << part) - 1);
+  uint64_t reg = lookup(pc1_tab, key);
+  for (size_type r = 0; r < rounds(); ++r) {
+    size_type k = rotations[r] % part;
+    if (k != 0) {
+      // Part p sits at integer bits size - (p + 1) * part .. size - p * part - 1
+      uint64_t next = 0;
+      for (size_type p = 0; p < registers; ++p) {
+        size_type shift = size - (p + 1) * part;
+        uint64_t v = (reg >> shift) & mask;
+        v = ((v << k) | (v >> (part - k))) & mask;
+        next |= v << shift;
+      }
+      reg = next;
+    }
+    round_keys[r] = lookup(pc2_tab, reg);
+  }
+}
+
+// Equivalent index tables (the same steps on key bit labels)
+std::vector<std::vector<size_type>> rotating_schedule::tables() const
+{
+  size_type part = pc1.op_size / registers;
+  std::vector<size_type> reg = pc1.main_table;
+  std::vector<size_type> next(reg.size());
+
+  std::vector<std::vector<size_type>> result;
+  for (size_type r = 0; r < rounds(); ++r) {
+    for (size_type p = 0; p < registers; ++p) {
+      for (size_type i = 0; i < part; ++i) {
+        next[p * part + i] = reg[p * part + (i + rotations[r]) % part];
+      }
+    }
+    reg.swap(next);
+    std::vector<size_type> round(pc2.op_size);
+    for (size_type j = 0; j < pc2.op_size; ++j) round[j] = reg[pc2.main_table[j]];
+    result.push_back(round);
+  }
+  return result;
+}
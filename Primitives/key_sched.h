@@ -0,0 +1,74 @@
+// Procedural key schedules: a key permutation, registers rotated
+// round by round, and a round key selection (PC-1, shifts, PC-2)
+
+/*
+ * SCHEDULE:
+ * The key is permuted by pc1 into a register of pc1.op_size bits, which
+ * is split into `registers` equal parts. Before round r every part is
+ * rotated left (towards index 0) by rotations[r], and the round key is
+ * the concatenation of the parts permuted by pc2. Rotations accumulate
+ * from round to round, as in DES.
+ */
+
+/*
+ * TABLES:
+ * Every round key bit is a single key bit, so the schedule also has an
+ * equivalent list of index tables (round_sch in feistel). They are
+ * derived once for the analyses that track key bits; expanding a key
+ * goes through word-level rotations instead.
+ */
+
+/*
+ * PACKED KEYS:
+ * When the key, the register and the round keys are all at most 64 bits
+ * (DES), pc1 and pc2 are compiled to byte lookup tables on packed
+ * integers (the convention of bitstr(value, size)) and the parts are
+ * rotated in place, so expand_packed costs a few dozen word operations
+ * per round and allocates nothing.
+ */
+
+#ifndef KEY_SCHED_H
+#define KEY_SCHED_H
+
+// Custom Libraries
+#include "bitstr.h"
+#include "perm.h"
+
+// Standard C++ Libraries
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+// Class
+class rotating_schedule {
+  public:
+    perm pc1;                             // key -> register
+    size_type registers;                  // number of parts rotated separately
+    std::vector<size_type> rotations;     // left rotation of every part before each round
+    perm pc2;                             // register -> round key
+
+    // Constructor
+    rotating_schedule(const perm& pc1, size_type registers, const std::vector<size_type>& rotations, const perm& pc2);
+
+    // Sizes
+    size_type key_size() const;
+    size_type rounds() const;
+    size_type round_key_size() const;
+
+    // Round keys of a key (one per round)
+    std::vector<bitstr> expand(const bitstr& key) const;
+
+    // Packed round keys of a packed key (needs packed())
+    bool packed() const;
+    void expand_packed(uint64_t key, uint64_t* round_keys) const;
+
+    // Equivalent index tables: round key bit j of round r is key bit tables()[r][j]
+    std::vector<std::vector<size_type>> tables() const;
+
+  private:
+    // Byte tables of pc1 and pc2 (empty unless packed)
+    std::vector<uint64_t> pc1_tab;
+    std::vector<uint64_t> pc2_tab;
+};
+
+#endif
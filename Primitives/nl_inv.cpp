@@ -0,0 +1,181 @@
+// Implementation of the nonlinear invariant search
+
+// Header Inclusion
+#include "nl_inv.h"
+
+// Helpers
+// Append all masks of the given weight over variables [from, n)
+static void add_monomials(std::vector<size_type>& out, size_type n, size_type from, uint weight, size_type mask) {
+  if (weight == 0) {
+    out.push_back(mask);
+    return;
+  }
+  for (size_type v = from; v + weight <= n; ++v) {
+    add_monomials(out, n, v + 1, weight - 1, mask | (size_type(1) << v));
+  }
+}
+
+// Constructor
+nl_inv::nl_inv(size_type n, uint degree, uint64_t seed) {
+  if (n == 0 || n > 64) {
+    throw std::invalid_argument("Number of variables must be between 1 and 64.");
+  }
+  if (degree == 0) {
+    throw std::invalid_argument("Degree must be at least 1.");
+  }
+  this->n = n;
+  this->degree = degree;
+  this->seed = seed;
+  for (uint d = 1; d <= degree && d <= n; ++d) {
+    add_monomials(monomials, n, 0, d, 0);
+  }
+}
+
+// Reduce a row against the current rows and keep it if independent
+bool nl_inv::insert(std::vector<block_type>& row) {
+  for (size_type k = 0; k < rows.size(); ++k) {
+    if ((row[pivots[k] / 64] >> (pivots[k] % 64)) & 1) {
+      for (size_type w = 0; w < row.size(); ++w) row[w] ^= rows[k][w];
+    }
+  }
+
+  // Find the pivot
+  size_type w = 0;
+  while (w < row.size() && row[w] == 0) ++w;
+  if (w == row.size()) return false;
+  size_type pivot = w * 64 + __builtin_ctzl(row[w]);
+
+  // Keep the rows fully reduced
+  for (auto& other : rows) {
+    if ((other[pivot / 64] >> (pivot % 64)) & 1) {
+      for (size_type i = 0; i < row.size(); ++i) other[i] ^= row[i];
+    }
+  }
+  rows.push_back(row);
+  pivots.push_back(pivot);
+  return true;
+}
+
+// Read a basis of the null space off the reduced rows
+void nl_inv::extract() {
+  size_type cols = monomials.size() + 1;
+  std::vector<bool> is_pivot(cols, false);
+  for (auto p : pivots) is_pivot[p] = true;
+
+  invariants.clear();
+  for (size_type f = 0; f < cols; ++f) {
+    if (is_pivot[f]) continue;
+
+    // Free column f set, pivots follow
+    std::vector<bool> sol(cols, false);
+    sol[f] = true;
+    for (size_type k = 0; k < rows.size(); ++k) {
+      sol[pivots[k]] = (rows[k][f / 64] >> (f % 64)) & 1;
+    }
+
+    invariant inv;
+    for (size_type j = 0; j < monomials.size(); ++j) {
+      if (sol[j]) inv.terms.push_back(monomials[j]);
+    }
+    inv.c = sol[cols - 1];
+    if (!inv.terms.empty()) invariants.push_back(inv);
+  }
+}
+
+// General solver
+void nl_inv::solve(const std::function<size_type(size_type)>& F) {
+  size_type cols = monomials.size() + 1;
+  size_type words = (cols + 63) / 64;
+  rows.clear();
+  pivots.clear();
+
+  // Equation for a single input
+  std::vector<block_type> row(words);
+  auto equation = [&](size_type x) {
+    size_type y = F(x);
+    std::fill(row.begin(), row.end(), 0);
+    for (size_type j = 0; j < monomials.size(); ++j) {
+      size_type u = monomials[j];
+      if (((x & u) == u) != ((y & u) == u)) row[j / 64] |= block_type(1) << (j % 64);
+    }
+    row[(cols - 1) / 64] |= block_type(1) << ((cols - 1) % 64);
+    return insert(row);
+  };
+
+  if (n <= EXHAUSTIVE_BITS) {
+    // Every input, stop once only the zero solution is left
+    for (size_type x = 0; x < (size_type(1) << n) && rows.size() < cols; ++x) {
+      equation(x);
+    }
+  }
+  else {
+    // Random inputs until the rank settles, then a check of the solutions
+    // on fresh inputs (a failure adds rank, and sampling starts over)
+    prng gen(seed);
+    bool settled = false;
+    while (!settled && rows.size() < cols) {
+      size_type stable = 0;
+      while (stable < STABLE_SAMPLES && rows.size() < cols) {
+        if (equation(gen.bits(n))) stable = 0;
+        else ++stable;
+      }
+      settled = true;
+      for (size_type i = 0; i < VERIFY_SAMPLES && rows.size() < cols; ++i) {
+        if (equation(gen.bits(n))) {
+          settled = false;
+          break;
+        }
+      }
+    }
+  }
+  extract();
+}
+
+// Solve for a bool_fn
+void nl_inv::solve(const bool_fn& fn) {
+  if (fn.in != n || fn.out != n) {
+    throw std::invalid_argument("Function size does not match the number of variables.");
+  }
+  solve([&](size_type x) { return size_type(fn[uint(x)]); });
+}
+
+// Solve for the keyless round function
+void nl_inv::solve_rfunc(const feistel& cipher) {
+  if (cipher.block_size / 2 != n) {
+    throw std::invalid_argument("Half block size does not match the number of variables.");
+  }
+  bitstr zero(cipher.rf_before.op_size);
+  solve([&](size_type x) {
+    return cipher.rfunc(bitstr(block_type(x), n), zero).value(0, n);
+  });
+}
+
+// Solve for the keyless full round
+void nl_inv::solve_round(const feistel& cipher) {
+  if (cipher.block_size != n) {
+    throw std::invalid_argument("Block size does not match the number of variables.");
+  }
+  size_type half = n / 2;
+  size_type mask = (size_type(1) << half) - 1;
+  bitstr zero(cipher.rf_before.op_size);
+  solve([&](size_type x) {
+    size_type left = x >> half;
+    size_type right = x & mask;
+    size_type f = cipher.rfunc(bitstr(block_type(right), half), zero).value(0, half);
+    return (right << half) | (left ^ f);
+  });
+}
+
+// Print invariants
+void nl_inv::print_invariants() const {
+  for (const auto& inv : invariants) {
+    std::cout << "g = ";
+    for (size_type t = 0; t < inv.terms.size(); ++t) {
+      if (t > 0) std::cout << " + ";
+      for (size_type j = 0; j < n; ++j) {
+        if (inv.terms[t] & (size_type(1) << j)) std::cout << "x" << j;
+      }
+    }
+    std::cout << ", c = " << inv.c << std::endl;
+  }
+}
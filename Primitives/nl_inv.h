@@ -0,0 +1,85 @@
+// Class to search for nonlinear invariants of bounded degree,
+// i.e. Boolean functions g with g(F(x)) = g(x) + c for a fixed map F
+
+/*
+ * METHOD:
+ * The coefficients of g over all monomials of degree 1..degree,
+ * together with c, are the unknowns. Every input x gives one linear
+ * equation sum_u a_u (F(x)^u + x^u) + c = 0, so the invariants are the
+ * null space of a bit-packed matrix that is row-reduced as the
+ * equations are generated.
+ */
+
+/*
+ * EXACTNESS:
+ * Maps on at most EXHAUSTIVE_BITS bits are evaluated on every input and
+ * the result is exact. Larger maps are sampled at random until the rank
+ * stops growing for STABLE_SAMPLES samples in a row, and the solutions
+ * are then checked on VERIFY_SAMPLES further random inputs; any failing
+ * input becomes a new equation and the solve goes on. The result is not
+ * exact: a false invariant that fails on a fraction e of the inputs is
+ * returned with probability about (1 - e)^VERIFY_SAMPLES, which is
+ * negligible for e >= 2^-10 but not for rarer failures. The samples are
+ * drawn from prng(seed), so a run can be repeated exactly.
+ */
+
+#ifndef NL_INV_H
+#define NL_INV_H
+
+// Customs
+#include "bool_fn.h"
+#include "feistel.h"
+#include "bitstr.h"
+#include "prng.h"
+
+// Mains
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <cstdlib>
+
+// Main Class
+class nl_inv
+{
+  public:
+    // Limits
+    static const size_type EXHAUSTIVE_BITS = 16;
+    static const size_type STABLE_SAMPLES = 128;
+    static const size_type VERIFY_SAMPLES = size_type(1) << 16;
+
+    // A single invariant
+    struct invariant
+    {
+      std::vector<size_type> terms;   // monomials of g, as variable masks
+      bool c;                         // g(F(x)) = g(x) + c
+    };
+
+    size_type n;                          // number of variables
+    uint degree;                          // maximum degree of g
+    std::vector<size_type> monomials;     // unknowns of the system (column order)
+    std::vector<invariant> invariants;    // basis of the solution space
+    uint64_t seed;                        // seed for sampled solves
+
+    // Constructor
+    nl_inv(size_type n, uint degree, uint64_t seed = 0);
+
+    // Solvers (each replaces the stored invariants)
+    void solve(const std::function<size_type(size_type)>& F);
+    void solve(const bool_fn& fn);                // S-box or any bijection with in == out
+    void solve_rfunc(const feistel& cipher);      // keyless round function, rfunc(x, 0)
+    void solve_round(const feistel& cipher);      // keyless full round, (L, R) -> (R, L + f(R))
+
+    // Print invariants
+    void print_invariants() const;
+
+  private:
+    // Row-reduced equations, one pivot column per row
+    std::vector<std::vector<block_type>> rows;
+    std::vector<size_type> pivots;
+
+    bool insert(std::vector<block_type>& row);
+    void extract();
+};
+
+#endif
@@ -0,0 +1,45 @@
+// Small helpers to split embarrassingly parallel loops
+// across the available hardware threads
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Standard C++ libraries
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+// Aliases for types
+using size_type = size_t;
+
+// Number of worker threads to use
+inline size_type thread_count()
+{
+  size_type n = std::thread::hardware_concurrency();
+  return (n == 0) ? 1 : n;
+}
+
+// Call fn(begin, end) on contiguous chunks of [0, total).
+// Ranges with less than min_chunk elements per thread are run inline.
+template <typename Fn>
+void parallel_for(size_type total, size_type min_chunk, Fn fn)
+{
+  if (total == 0) return;
+  size_type workers = std::min(thread_count(), std::max<size_type>(1, total / std::max<size_type>(1, min_chunk)));
+  if (workers <= 1) {
+    fn(size_type(0), total);
+    return;
+  }
+
+  // Split evenly, the calling thread takes the last chunk
+  std::vector<std::thread> pool;
+  size_type step = (total + workers - 1) / workers;
+  for (size_type beg = 0; beg + step < total; beg += step) {
+    pool.emplace_back(fn, beg, beg + step);
+  }
+  fn(pool.size() * step, total);
+  for (auto& t : pool) t.join();
+}
+
+#endif
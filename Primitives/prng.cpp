@@ -0,0 +1,130 @@
+// Implementation of the xoshiro256** generator
+
+// Header Inclusion
+#include "prng.h"
+
+// Helpers
+static inline uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+// splitmix64 step, used to expand seeds into full states
+static inline uint64_t splitmix64(uint64_t& x)
+{
+  uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Four xoshiro256** lanes side by side
+typedef uint64_t prng_lane __attribute__((vector_size(32)));
+
+// Constructor
+prng::prng(uint64_t seed, uint64_t stream)
+{
+  // Mix the stream index in first, so nearby (seed, stream) pairs diverge
+  uint64_t x = stream;
+  x = splitmix64(x) ^ seed;
+  for (size_type i = 0; i < 4; ++i) s[i] = splitmix64(x);
+  if ((s[0] | s[1] | s[2] | s[3]) == 0) s[0] = 1;
+}
+
+// Next output
+uint64_t prng::next()
+{
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+// Uniform word of the given size
+uint64_t prng::bits(size_type size)
+{
+  if (size == 0) return 0;
+  return next() >> (64 - std::min<size_type>(size, 64));
+}
+
+// Uniform integer below bound (multiply-shift with rejection)
+uint64_t prng::below(uint64_t bound)
+{
+  __uint128_t m = __uint128_t(next()) * bound;
+  uint64_t low = uint64_t(m);
+  if (low < bound) {
+    uint64_t threshold = -bound % bound;
+    while (low < threshold) {
+      m = __uint128_t(next()) * bound;
+      low = uint64_t(m);
+    }
+  }
+  return uint64_t(m >> 64);
+}
+
+// Bulk generation
+void prng::fill(uint64_t* output, size_type count, size_type size)
+{
+  uint64_t mask = (size >= 64) ? ~uint64_t(0) : ((uint64_t(1) << size) - 1);
+
+  // Seed the lanes from this generator (lane k is element k of every state word)
+  prng_lane v[4];
+  for (size_type i = 0; i < 4; ++i) {
+    for (size_type k = 0; k < 4; ++k) {
+      uint64_t x = next();
+      v[i][k] = splitmix64(x);
+    }
+  }
+  for (size_type k = 0; k < 4; ++k) {
+    if ((v[0][k] | v[1][k] | v[2][k] | v[3][k]) == 0) v[0][k] = 1;
+  }
+
+  // Four words per step, the last step may be partial
+  for (size_type pos = 0; pos < count; pos += 4) {
+    prng_lane m = v[1] * 5;
+    prng_lane result = ((m << 7) | (m >> 57)) * 9;
+    prng_lane t = v[1] << 17;
+    v[2] ^= v[0];
+    v[3] ^= v[1];
+    v[1] ^= v[2];
+    v[0] ^= v[3];
+    v[2] ^= t;
+    v[3] = (v[3] << 45) | (v[3] >> 19);
+
+    result &= mask;
+    size_type take = std::min<size_type>(4, count - pos);
+    for (size_type k = 0; k < take; ++k) output[pos + k] = result[k];
+  }
+}
+
+// Advance by 2^128 outputs
+void prng::jump()
+{
+  static const uint64_t JUMP[4] = {
+    0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+    0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+  };
+  uint64_t t[4] = {0, 0, 0, 0};
+  for (size_type i = 0; i < 4; ++i) {
+    for (size_type b = 0; b < 64; ++b) {
+      if ((JUMP[i] >> b) & 1) {
+        for (size_type k = 0; k < 4; ++k) t[k] ^= s[k];
+      }
+      next();
+    }
+  }
+  for (size_type k = 0; k < 4; ++k) s[k] = t[k];
+}
+
+// Hand out the current stream and move past it
+prng prng::split()
+{
+  prng piece = *this;
+  jump();
+  return piece;
+}
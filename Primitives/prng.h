@@ -0,0 +1,64 @@
+// Seedable pseudo-random generator (xoshiro256**) for sampling
+// plaintexts, keys and inputs in experiments
+
+/*
+ * STREAMS:
+ * A generator is fixed by a seed and a stream index; the state is
+ * expanded from both with splitmix64, so prng(seed, i) for i = 0, 1, ...
+ * gives independent generators without any coordination. This is what
+ * per-thread or per-chunk sampling should use: results then depend only
+ * on the seed and the chunking, never on scheduling. jump() advances by
+ * 2^128 outputs, and split() hands out such non-overlapping pieces of a
+ * single stream.
+ */
+
+/*
+ * BULK GENERATION:
+ * fill() seeds four lanes from the generator and runs them side by side
+ * in a GCC vector, which compiles to SIMD instructions where the target
+ * has them. It consumes a fixed number of outputs of the generator, so a
+ * sequence of calls is reproducible, but its words differ from those of
+ * repeated next() calls.
+ */
+
+#ifndef PRNG_H
+#define PRNG_H
+
+// Standard C++ libraries
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+
+// Aliases for types
+using size_type = size_t;
+
+// Class Definition
+class prng {
+  public:
+    // UniformRandomBitGenerator interface
+    using result_type = uint64_t;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    // Constructor
+    prng(uint64_t seed = 0, uint64_t stream = 0);
+
+    // Single outputs
+    uint64_t next();
+    uint64_t operator()() { return next(); }
+    uint64_t bits(size_type size);                  // uniform in [0, 2^size), size <= 64
+    uint64_t below(uint64_t bound);                 // uniform in [0, bound), bound > 0
+
+    // Bulk: count words of size bits each (packed blocks, high bits zero)
+    void fill(uint64_t* output, size_type count, size_type size = 64);
+
+    // Stream splitting
+    void jump();                                    // advance by 2^128 outputs
+    prng split();                                   // copy of this stream, then jump()
+
+  private:
+    uint64_t s[4];
+};
+
+#endif
@@ -0,0 +1,238 @@
+// Implementation of round function correlation matrices and hulls
+
+// Header Inclusion
+#include "rf_corr.h"
+
+// Standard C++ Libraries
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+
+// Helpers
+static inline int parity(uint64_t x)
+{
+  return __builtin_popcountll(x) & 1;
+}
+
+// Per-S-Box data for expanding columns
+struct rf_sbox {
+  size_type shift;                                                  // of its inputs in a packed S-Box mask
+  std::vector<uint64_t> contrib;                                    // input mask w_s -> half mask
+  std::vector<std::vector<std::pair<uint64_t, double>>> lat;        // output mask -> non-zero (w_s, corr)
+};
+
+// Expand the terms of one column over the active S-Boxes
+static void expand(const std::vector<rf_sbox>& boxes, const std::vector<std::pair<size_type, uint64_t>>& active,
+                   size_type k, uint64_t u, uint64_t w, double prod, double threshold, std::vector<rf_corr::entry>& out)
+{
+  if (k == active.size()) {
+    out.push_back({u, w, prod});
+    return;
+  }
+  const rf_sbox& box = boxes[active[k].first];
+  for (const auto& [ws, c] : box.lat[active[k].second]) {
+    double p = prod * c;
+    if (std::abs(p) < threshold) continue;
+    expand(boxes, active, k + 1, u ^ box.contrib[ws], w | (ws << box.shift), p, threshold, out);
+  }
+}
+
+// Constructor
+rf_corr::rf_corr(const feistel& cipher, double threshold)
+{
+  half = cipher.block_size / 2;
+  sbox_bits = cipher.rf_before.op_size;
+  this->threshold = threshold;
+  if (half > MAX_HALF) {
+    throw std::invalid_argument("Correlation matrices need a half block of at most 24 bits.");
+  }
+  if (sbox_bits > 64) {
+    throw std::invalid_argument("S-Box inputs must fit in 64 bits.");
+  }
+
+  // S-Box spectra and where their bits go
+  std::vector<rf_sbox> boxes(cipher.sboxes.size());
+  std::vector<size_type> out_box(cipher.rf_after.ip_size);
+  std::vector<size_type> out_pos(cipher.rf_after.ip_size);
+  size_type istart = 0, ostart = 0;
+  for (size_type s = 0; s < cipher.sboxes.size(); ++s) {
+    size_type m = cipher.sboxes[s].input_size;
+    size_type p = cipher.sboxes[s].output_size;
+    rf_sbox& box = boxes[s];
+    box.shift = sbox_bits - istart - m;
+    box.contrib.assign(size_type(1) << m, 0);
+    for (size_type w = 0; w < box.contrib.size(); ++w) {
+      for (size_type t = 0; t < m; ++t) {
+        if ((w >> t) & 1) box.contrib[w] ^= uint64_t(1) << (half - 1 - cipher.rf_before.main_table[istart + m - 1 - t]);
+      }
+    }
+    const std::vector<int>& walsh = bool_fn(cipher.sboxes[s]).get_walsh();
+    box.lat.resize(size_type(1) << p);
+    for (size_type z = 0; z < box.lat.size(); ++z) {
+      for (size_type w = 0; w < (size_type(1) << m); ++w) {
+        int c = walsh[(z << m) | w];
+        if (c != 0) box.lat[z].emplace_back(w, double(c) / double(size_type(1) << m));
+      }
+    }
+    for (size_type j = 0; j < p; ++j) {
+      out_box[ostart + j] = s;
+      out_pos[ostart + j] = p - 1 - j;
+    }
+    istart += m;
+    ostart += p;
+  }
+
+  // Columns in chunks, each chunk in its own buffer
+  const size_type CHUNK = 1 << 10;
+  size_type columns = size_type(1) << half;
+  size_type chunks = (columns + CHUNK - 1) / CHUNK;
+  std::vector<std::vector<entry>> parts(chunks);
+  std::vector<size_type> counts(columns);
+  parallel_for(chunks, 1, [&](size_type beg, size_type end) {
+    std::vector<uint64_t> z(boxes.size());
+    std::vector<std::pair<size_type, uint64_t>> active;
+    for (size_type c = beg; c < end; ++c) {
+      for (size_type v = c * CHUNK; v < std::min(columns, (c + 1) * CHUNK); ++v) {
+        std::fill(z.begin(), z.end(), 0);
+        for (size_type i = 0; i < half; ++i) {
+          if ((v >> (half - 1 - i)) & 1) {
+            size_type j = cipher.rf_after.main_table[i];
+            z[out_box[j]] ^= uint64_t(1) << out_pos[j];
+          }
+        }
+        active.clear();
+        for (size_type s = 0; s < boxes.size(); ++s) {
+          if (z[s] != 0) active.emplace_back(s, z[s]);
+        }
+        size_type first = parts[c].size();
+        expand(boxes, active, 0, 0, 0, 1.0, threshold, parts[c]);
+        std::sort(parts[c].begin() + first, parts[c].end(), [](const entry& x, const entry& y) { return x.in_mask < y.in_mask; });
+        counts[v] = parts[c].size() - first;
+      }
+    }
+  });
+
+  // Join the chunks
+  offsets.assign(columns + 1, 0);
+  for (size_type v = 0; v < columns; ++v) offsets[v + 1] = offsets[v] + counts[v];
+  entries.reserve(offsets[columns]);
+  for (auto& part : parts) {
+    entries.insert(entries.end(), part.begin(), part.end());
+    std::vector<entry>().swap(part);
+  }
+}
+
+// Columns
+std::pair<const rf_corr::entry*, const rf_corr::entry*> rf_corr::column(uint64_t out_mask) const
+{
+  if (out_mask >= (uint64_t(1) << half)) {
+    throw std::invalid_argument("Mask does not fit half of the block size.");
+  }
+  return {entries.data() + offsets[out_mask], entries.data() + offsets[out_mask + 1]};
+}
+
+size_type rf_corr::size() const
+{
+  return entries.size();
+}
+
+// Single correlations
+double rf_corr::correlation(uint64_t in_mask, uint64_t out_mask) const
+{
+  auto [beg, end] = column(out_mask);
+  auto it = std::lower_bound(beg, end, in_mask, [](const entry& e, uint64_t m) { return e.in_mask < m; });
+  double result = 0;
+  for (; it != end && it->in_mask == in_mask; ++it) result += it->corr;
+  return result;
+}
+
+double rf_corr::correlation(uint64_t in_mask, uint64_t out_mask, const bitstr& round_key) const
+{
+  if (round_key.bit_size != sbox_bits) {
+    throw std::invalid_argument("Round key must match size of permuted input.");
+  }
+  uint64_t k = round_key.value(0, sbox_bits);
+  auto [beg, end] = column(out_mask);
+  auto it = std::lower_bound(beg, end, in_mask, [](const entry& e, uint64_t m) { return e.in_mask < m; });
+  double result = 0;
+  for (; it != end && it->in_mask == in_mask; ++it) result += parity(it->sbox_mask & k) ? -it->corr : it->corr;
+  return result;
+}
+
+// One round
+rf_corr::vec rf_corr::step(const vec& masks, bool last, const uint64_t* round_key, double cutoff) const
+{
+  std::vector<std::pair<uint64_t, double>> items(masks.begin(), masks.end());
+  uint64_t low = (uint64_t(1) << half) - 1;
+  std::vector<vec> partials;
+  std::mutex lock;
+  parallel_for(items.size(), 64, [&](size_type beg, size_type end) {
+    vec local;
+    for (size_type i = beg; i < end; ++i) {
+      uint64_t a = items[i].first >> half;
+      uint64_t b = items[i].first & low;
+      double c = items[i].second;
+      auto [cb, ce] = column(a);
+      for (const entry* e = cb; e != ce; ++e) {
+        double t = (round_key && parity(e->sbox_mask & *round_key)) ? -c * e->corr : c * e->corr;
+        uint64_t next = last ? ((a << half) | (b ^ e->in_mask)) : (((b ^ e->in_mask) << half) | a);
+        local[next] += t;
+      }
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    partials.push_back(std::move(local));
+  });
+
+  // Merge and drop what fell below the cutoff
+  if (partials.empty()) return {};
+  vec result = std::move(partials[0]);
+  for (size_type p = 1; p < partials.size(); ++p) {
+    for (const auto& [m, c] : partials[p]) result[m] += c;
+  }
+  for (auto it = result.begin(); it != result.end();) {
+    if (it->second == 0 || std::abs(it->second) < cutoff) it = result.erase(it);
+    else ++it;
+  }
+  return result;
+}
+
+// Hull propagation
+rf_corr::vec rf_corr::run(const vec& masks, size_type rounds, const feistel::key_schedule* key, double cutoff) const
+{
+  for (const auto& [m, c] : masks) {
+    if (m >> (2 * half)) throw std::invalid_argument("Mask does not fit the block size.");
+  }
+  if (key && rounds > key->round_keys.size()) {
+    throw std::invalid_argument("Number of rounds exceeds maximum allowed.");
+  }
+  vec result = masks;
+  for (size_type r = 0; r < rounds && !result.empty(); ++r) {
+    uint64_t k = key ? key->round_keys[r].value(0, sbox_bits) : 0;
+    result = step(result, r + 1 == rounds, key ? &k : nullptr, cutoff);
+  }
+  return result;
+}
+
+rf_corr::vec rf_corr::propagate(const vec& masks, size_type rounds, double cutoff) const
+{
+  return run(masks, rounds, nullptr, cutoff);
+}
+
+rf_corr::vec rf_corr::propagate(const vec& masks, size_type rounds, const feistel::key_schedule& key, double cutoff) const
+{
+  return run(masks, rounds, &key, cutoff);
+}
+
+double rf_corr::hull(uint64_t in_mask, uint64_t out_mask, size_type rounds, double cutoff) const
+{
+  vec result = propagate({{in_mask, 1.0}}, rounds, cutoff);
+  auto it = result.find(out_mask);
+  return (it == result.end()) ? 0 : it->second;
+}
+
+double rf_corr::hull(uint64_t in_mask, uint64_t out_mask, size_type rounds, const feistel::key_schedule& key, double cutoff) const
+{
+  vec result = propagate({{in_mask, 1.0}}, rounds, key, cutoff);
+  auto it = result.find(out_mask);
+  return (it == result.end()) ? 0 : it->second;
+}
@@ -0,0 +1,91 @@
+// Exact correlation matrix of the round function on small halves, and
+// linear hull propagation through the Feistel structure with it
+
+/*
+ * MATRIX:
+ * F(x) = rf_after(S(rf_before(x) ^ k)) with linear rf_before and
+ * rf_after, so the correlation of (u, v) is a sum over S-Box input masks
+ * w with rf_before^T w = u of the products of S-Box correlations at
+ * (w_s, z_s), z = rf_after^T v. The S-Box spectra come from the fast
+ * Walsh transform (bool_fn); column v is expanded over the active
+ * S-Boxes, dropping partial products below the threshold. Each entry
+ * keeps its w, so a round key only flips signs: (-1)^(w.k).
+ * Columns are stored one after the other (CSR), built in parallel.
+ * Small S-Boxes have dense spectra, so without a threshold the number
+ * of terms grows about as fast as 2^half times the product of the
+ * active S-Box column sizes; the threshold is what keeps it in memory.
+ */
+
+/*
+ * HULLS:
+ * Masks on the block are packed as by bitstr(value, block_size) on the
+ * state after ip and before fp, i.e. (left << half) | right, as in
+ * attack and corr_exact. A round takes (a, b) to (b ^ u, a) with weight
+ * C(u, a), and the last one (no swap) to (a, b ^ u). Sparse vectors of
+ * masks are pushed through round by round in parallel and entries below
+ * the threshold are dropped after each round; with both thresholds at 0
+ * and the key's round keys the result is the exact correlation.
+ */
+
+#ifndef RF_CORR_H
+#define RF_CORR_H
+
+// Custom Libraries
+#include "bitstr.h"
+#include "feistel.h"
+#include "bool_fn.h"
+#include "parallel.h"
+
+// Standard C++ Libraries
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <stdexcept>
+
+// Class
+class rf_corr {
+  public:
+    static constexpr size_type MAX_HALF = 24;
+
+    // One term of a column: input mask, S-Box input mask, keyless correlation
+    struct entry {
+      uint64_t in_mask;
+      uint64_t sbox_mask;
+      double corr;
+    };
+
+    // Sparse vector of block masks
+    using vec = std::unordered_map<uint64_t, double>;
+
+    size_type half;
+    size_type sbox_bits;            // rf_before.op_size
+    double threshold;
+
+    // Constructor (all columns, terms with |corr| below threshold dropped)
+    rf_corr(const feistel& cipher, double threshold = 0);
+
+    // Column of an output mask, sorted by input mask (a mask may repeat)
+    std::pair<const entry*, const entry*> column(uint64_t out_mask) const;
+    size_type size() const;
+
+    // Correlation of (in_mask, out_mask) without a key, or with a round key
+    double correlation(uint64_t in_mask, uint64_t out_mask) const;
+    double correlation(uint64_t in_mask, uint64_t out_mask, const bitstr& round_key) const;
+
+    // Hull propagation over rounds (keyless, or under the rounds of a key)
+    vec propagate(const vec& masks, size_type rounds, double cutoff = 0) const;
+    vec propagate(const vec& masks, size_type rounds, const feistel::key_schedule& key, double cutoff = 0) const;
+    double hull(uint64_t in_mask, uint64_t out_mask, size_type rounds, double cutoff = 0) const;
+    double hull(uint64_t in_mask, uint64_t out_mask, size_type rounds, const feistel::key_schedule& key, double cutoff = 0) const;
+
+  private:
+    std::vector<size_type> offsets;     // column v is entries[offsets[v] .. offsets[v + 1])
+    std::vector<entry> entries;
+
+    // One round (swap unless last), signs from a packed round key
+    vec step(const vec& masks, bool last, const uint64_t* round_key, double cutoff) const;
+    vec run(const vec& masks, size_type rounds, const feistel::key_schedule* key, double cutoff) const;
+};
+
+#endif
@@ -2,6 +2,7 @@
 
 // Include header
 #include "sbox.h"
+#include "sbox_cache.h"
 
 // Helper function to compute dot products (bitwise)
 bool bit_dot(short_type a, short_type b)
@@ -106,3 +107,19 @@ void sbox::print_lat()
   }
   std::cout << std::endl;
 }
+
+// Cached analyses
+size_type sbox::degree() const
+{
+  return sbox_cache::shared().lookup(*this).degree;
+}
+
+size_type sbox::linearity() const
+{
+  return sbox_cache::shared().lookup(*this).linearity;
+}
+
+size_type sbox::uniformity() const
+{
+  return sbox_cache::shared().lookup(*this).uniformity;
+}
@@ -37,6 +37,11 @@ class sbox {
 
     // Print LAT
     void print_lat();
+
+    // Affine invariants, through the shared sbox_cache (equivalent boxes are analysed once)
+    size_type degree() const;
+    size_type linearity() const;      // max |Walsh| over non-zero output masks
+    size_type uniformity() const;     // max DDT entry over non-zero input differences
 };
 
 #endif
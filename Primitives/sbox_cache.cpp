@@ -0,0 +1,331 @@
+// Implementation of affine canonical forms and the analysis cache
+
+// Header Inclusion
+#include "sbox_cache.h"
+
+// Standard C++ Libraries
+#include <cstdio>
+
+// System
+#include <unistd.h>
+
+// Helpers
+// Scratch space for greedy_output, sized for the output space once
+struct greedy_state
+{
+  std::vector<size_type> bmap;    // B on the span of seen outputs (NONE elsewhere)
+  std::vector<bool> taken;        // span of the images
+  std::vector<size_type> span;    // seen outputs, to reset bmap/taken cheaply
+};
+
+static const size_type NONE = ~size_type(0);
+
+// Smallest B(T) (T linearly mapped on the output side), written to cand.
+// Gives up and returns false as soon as cand would exceed best.
+static bool greedy_output(const std::vector<size_type>& T, greedy_state& st,
+                          std::vector<size_type>& cand, const std::vector<size_type>& best)
+{
+  // Reset what the previous call touched
+  for (auto s : st.span) {
+    st.taken[st.bmap[s]] = false;
+    st.bmap[s] = NONE;
+  }
+  st.span.assign(1, 0);
+  st.bmap[0] = 0;
+  st.taken[0] = true;
+
+  bool tied = !best.empty();
+  size_type next_free = 1;
+  for (size_type x = 0; x < T.size(); ++x) {
+    size_type v = T[x];
+    if (st.bmap[v] == NONE) {
+      // New direction: map it to the smallest image still available
+      while (st.taken[next_free]) ++next_free;
+      size_type q = next_free;
+      size_type count = st.span.size();
+      for (size_type i = 0; i < count; ++i) {
+        size_type s = st.span[i];
+        st.bmap[s ^ v] = st.bmap[s] ^ q;
+        st.taken[st.bmap[s] ^ q] = true;
+        st.span.push_back(s ^ v);
+      }
+    }
+    cand[x] = st.bmap[v];
+
+    // Compare with the best so far
+    if (tied) {
+      if (cand[x] > best[x]) return false;
+      if (cand[x] < best[x]) tied = false;
+    }
+  }
+  return !tied;
+}
+
+// Enumerate the columns of every invertible in x in matrix, calling fn(ax) with ax[x] = A x
+template <typename Fn>
+static void for_each_gl(size_type in, std::vector<size_type>& cols, std::vector<bool>& spanned, Fn& fn)
+{
+  size_type size = size_type(1) << in;
+  if (cols.size() == in) {
+    std::vector<size_type> ax(size, 0);
+    for (size_type x = 1; x < size; ++x) {
+      size_type low = __builtin_ctzl(x);
+      ax[x] = ax[x & (x - 1)] ^ cols[low];
+    }
+    fn(ax);
+    return;
+  }
+
+  // Next column outside the span of the previous ones
+  for (size_type c = 1; c < size; ++c) {
+    if (spanned[c]) continue;
+    std::vector<bool> next = spanned;
+    for (size_type s = 0; s < size; ++s) {
+      if (spanned[s]) next[s ^ c] = true;
+    }
+    cols.push_back(c);
+    for_each_gl(in, cols, next, fn);
+    cols.pop_back();
+  }
+}
+
+// Smallest table over the input maps given (every matrix in GL(n) with
+// full_gl, the identity otherwise), translations and output maps
+static std::vector<size_type> canonical_form(size_type in, size_type out, const std::vector<size_type>& table,
+                                             bool affine, bool full_gl)
+{
+  size_type size = size_type(1) << in;
+  std::vector<size_type> best;
+  std::vector<size_type> cand(size);
+  std::vector<size_type> T(size);
+  greedy_state st{std::vector<size_type>(size_type(1) << out, NONE), std::vector<bool>(size_type(1) << out, false), {}};
+  auto try_matrix = [&](const std::vector<size_type>& ax) {
+    for (size_type a = 0; a < (affine ? size : 1); ++a) {
+      for (size_type x = 0; x < size; ++x) {
+        T[x] = table[ax[x] ^ a];
+      }
+      if (affine) {
+        size_type b = T[0];
+        for (size_type x = 0; x < size; ++x) T[x] ^= b;
+      }
+      if (greedy_output(T, st, cand, best)) best = cand;
+    }
+  };
+
+  if (!full_gl) {
+    std::vector<size_type> ax(size);
+    for (size_type x = 0; x < size; ++x) ax[x] = x;
+    try_matrix(ax);
+    return best;
+  }
+  std::vector<size_type> cols;
+  std::vector<bool> spanned(size, false);
+  spanned[0] = true;
+  for_each_gl(in, cols, spanned, try_matrix);
+  return best;
+}
+
+// Canonical representative of the equivalence class of a table
+std::vector<size_type> affine_canonical(size_type in, size_type out, const std::vector<size_type>& table, bool affine)
+{
+  if (in < 1 || in > CANON_MAX_BITS) {
+    throw std::invalid_argument("Canonical form is only available for 1 to 4 input bits.");
+  }
+  if (out > 16) {
+    throw std::invalid_argument("Canonical form is only available for up to 16 output bits.");
+  }
+  size_type size = size_type(1) << in;
+  if (table.size() != size) {
+    throw std::invalid_argument("Table size does not match input size.");
+  }
+  for (auto v : table) {
+    if (v >= (size_type(1) << out)) {
+      throw std::invalid_argument("Table value exceeds output size.");
+    }
+  }
+  return canonical_form(in, out, table, affine, true);
+}
+
+// Constructors
+sbox_cache::sbox_cache() : hits(0), misses(0)
+{}
+
+sbox_cache::sbox_cache(const std::string& path) : path(path), hits(0), misses(0)
+{
+  load();
+}
+
+// Analyse a single table
+sbox_cache::entry sbox_cache::analyse(size_type in, size_type out, const std::vector<size_type>& table)
+{
+  size_type size = size_type(1) << in;
+  std::vector<uint> values(table.begin(), table.end());
+  entry result;
+
+  // Walsh spectrum, indexed by (output_mask << in) | input_mask
+  bool_fn fn(uint(in), uint(out), values);
+  const std::vector<int>& walsh = fn.get_walsh();
+  result.linearity = 0;
+  result.lat_spectrum.assign(size + 1, 0);
+  for (size_type i = size; i < walsh.size(); ++i) {
+    size_type w = std::abs(walsh[i]);
+    result.linearity = std::max(result.linearity, w);
+    result.lat_spectrum[w]++;
+  }
+
+  // Difference distribution
+  result.uniformity = 0;
+  result.ddt_spectrum.assign(size + 1, 0);
+  std::vector<size_type> row(size_type(1) << out);
+  for (size_type a = 1; a < size; ++a) {
+    std::fill(row.begin(), row.end(), 0);
+    for (size_type x = 0; x < size; ++x) {
+      row[table[x] ^ table[x ^ a]]++;
+    }
+    for (auto count : row) {
+      result.uniformity = std::max(result.uniformity, count);
+      result.ddt_spectrum[count]++;
+    }
+  }
+
+  // Degree (maximum over the coordinate functions)
+  result.degree = 0;
+  for (size_type j = 0; j < out; ++j) {
+    std::vector<uint> coord(size);
+    for (size_type x = 0; x < size; ++x) coord[x] = (table[x] >> j) & 1;
+    bool_fn comp(uint(in), 1, coord);
+    const std::vector<uint>& poly = comp.get_polynomial();
+    for (size_type u = 0; u < size; ++u) {
+      if (poly[u]) result.degree = std::max(result.degree, size_type(__builtin_popcountl(u)));
+    }
+  }
+  return result;
+}
+
+// Lookups
+sbox_cache& sbox_cache::shared()
+{
+  static sbox_cache cache;
+  return cache;
+}
+
+const sbox_cache::entry& sbox_cache::lookup(size_type in, size_type out, const std::vector<size_type>& table)
+{
+  if (in < 1 || in > CACHE_MAX_BITS || out > CACHE_MAX_BITS) {
+    throw std::invalid_argument("S-box cache only holds boxes of 1 to 10 input and at most 10 output bits.");
+  }
+  if (table.size() != (size_type(1) << in)) {
+    throw std::invalid_argument("Table size does not match input size.");
+  }
+  for (auto v : table) {
+    if (v >= (size_type(1) << out)) {
+      throw std::invalid_argument("Table value exceeds output size.");
+    }
+  }
+  std::vector<size_type> raw = {in, out};
+  raw.insert(raw.end(), table.begin(), table.end());
+
+  // A table that is itself a stored form, or one canonicalised before, is a
+  // hit without canonicalising again
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = entries.find(raw);
+    if (it == entries.end()) {
+      auto known = forms.find(raw);
+      if (known != forms.end()) it = entries.find(known->second);
+    }
+    if (it != entries.end()) {
+      hits++;
+      return it->second;
+    }
+  }
+
+  // Canonicalise outside the lock (wide boxes only up to translations and output maps)
+  std::vector<size_type> key = {in, out};
+  std::vector<size_type> form = canonical_form(in, out, table, true, in <= CANON_MAX_BITS);
+  key.insert(key.end(), form.begin(), form.end());
+
+  std::lock_guard<std::mutex> guard(lock);
+  forms[raw] = key;
+  auto it = entries.find(key);
+  if (it != entries.end()) {
+    hits++;
+    return it->second;
+  }
+  misses++;
+  return entries.emplace(key, analyse(in, out, form)).first->second;
+}
+
+const sbox_cache::entry& sbox_cache::lookup(const sbox& box)
+{
+  std::vector<size_type> table(box.table, box.table + (size_type(1) << box.input_size));
+  return lookup(box.input_size, box.output_size, table);
+}
+
+const sbox_cache::entry& sbox_cache::lookup(const bool_fn& fn)
+{
+  std::vector<size_type> table(fn.values.begin(), fn.values.end());
+  return lookup(fn.in, fn.out, table);
+}
+
+// Load the backing file, one entry per line:
+// in out table[2^in] degree linearity uniformity lat_spectrum[2^in+1] ddt_spectrum[2^in+1]
+void sbox_cache::load()
+{
+  if (path.empty()) return;
+  std::ifstream file(path);
+  if (!file) return;
+
+  std::lock_guard<std::mutex> guard(lock);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream ss(line);
+    size_type in, out;
+    if (!(ss >> in >> out)) continue;
+    if (in < 1 || in > CACHE_MAX_BITS || out > CACHE_MAX_BITS) {
+      throw std::runtime_error("Corrupt S-box cache file: " + path);
+    }
+    size_type size = size_type(1) << in;
+    std::vector<size_type> key = {in, out};
+    key.resize(size + 2);
+    entry e;
+    e.lat_spectrum.resize(size + 1);
+    e.ddt_spectrum.resize(size + 1);
+    for (size_type i = 2; i < key.size(); ++i) ss >> key[i];
+    ss >> e.degree >> e.linearity >> e.uniformity;
+    for (auto& v : e.lat_spectrum) ss >> v;
+    for (auto& v : e.ddt_spectrum) ss >> v;
+    if (!ss) {
+      throw std::runtime_error("Corrupt S-box cache file: " + path);
+    }
+    entries[key] = e;
+  }
+}
+
+// Write all entries to the backing file
+void sbox_cache::save() const
+{
+  if (path.empty()) return;
+
+  // Write beside the file and rename, so readers never see a partial cache
+  std::string tmp = path + ".tmp." + std::to_string(getpid());
+  std::ofstream file(tmp);
+  if (!file) {
+    throw std::runtime_error("Cannot write S-box cache file: " + path);
+  }
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    for (const auto& [key, e] : entries) {
+      for (auto v : key) file << v << " ";
+      file << e.degree << " " << e.linearity << " " << e.uniformity;
+      for (auto v : e.lat_spectrum) file << " " << v;
+      for (auto v : e.ddt_spectrum) file << " " << v;
+      file << "\n";
+    }
+  }
+  file.close();
+  if (!file || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("Cannot write S-box cache file: " + path);
+  }
+}
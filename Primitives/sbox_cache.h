@@ -0,0 +1,95 @@
+// Affine-equivalence canonical forms for small S-boxes and a
+// persistent cache of analyses keyed by that form
+
+/*
+ * CANONICAL FORM:
+ * Two S-boxes S and S' are affine equivalent if S'(x) = B(S(A x + a)) + b
+ * for invertible linear A, B. The canonical form is the lexicographically
+ * smallest table in the class: every (A, a) is tried, and for each the
+ * smallest B (and b) is found greedily, entry by entry. With affine set to
+ * false only linear A and B are used. For boxes wider than
+ * CANON_MAX_BITS, A is the identity (GL(n) is too large): the form is the
+ * smallest over input translations and output affine maps, so wide boxes
+ * equal up to those share an entry. The form of every table looked up is
+ * remembered, so a repeated lookup never canonicalises again.
+ */
+
+/*
+ * CACHED ANALYSES:
+ * Only properties that are invariant under affine equivalence are kept:
+ * algebraic degree, linearity and the |LAT| spectrum, differential
+ * uniformity and the DDT spectrum. Cycle structure and invariants change
+ * under A and B and have to be computed on the box itself. sbox and
+ * bool_fn answer degree, linearity and uniformity through the shared
+ * cache, which is safe to use from several threads. save writes a
+ * temporary file and renames it over the backing file.
+ */
+
+#ifndef SBOX_CACHE_H
+#define SBOX_CACHE_H
+
+// Customs
+#include "sbox.h"
+#include "bool_fn.h"
+
+// Mains
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <stdexcept>
+#include <mutex>
+
+// Largest input size for canonicalisation (|GL(n)| grows too fast beyond)
+const size_type CANON_MAX_BITS = 4;
+
+// Largest input and output size the cache analyses (the Walsh spectrum has 2^(in + out) entries)
+const size_type CACHE_MAX_BITS = 10;
+
+// Canonical representative of the equivalence class of a table
+std::vector<size_type> affine_canonical(size_type in, size_type out, const std::vector<size_type>& table, bool affine = true);
+
+// Main Class
+class sbox_cache
+{
+  public:
+    // Analyses shared by a whole equivalence class
+    struct entry
+    {
+      size_type degree;                       // algebraic degree
+      size_type linearity;                    // max |LAT| (Walsh) over non-zero output masks
+      size_type uniformity;                   // max DDT entry over non-zero input differences
+      std::vector<size_type> lat_spectrum;    // lat_spectrum[v] = #(a, b != 0) with |W(a, b)| = v
+      std::vector<size_type> ddt_spectrum;    // ddt_spectrum[v] = #(a != 0, b) with DDT(a, b) = v
+    };
+
+    std::string path;                                   // backing file (empty for memory only)
+    std::map<std::vector<size_type>, entry> entries;    // keyed by {in, out, canonical table}
+    size_type hits;
+    size_type misses;
+
+    // Constructors (loads the backing file if it exists)
+    sbox_cache();
+    sbox_cache(const std::string& path);
+
+    // Process-wide cache (memory only) used by sbox and bool_fn
+    static sbox_cache& shared();
+
+    // Lookups (analyse and store on a miss)
+    const entry& lookup(size_type in, size_type out, const std::vector<size_type>& table);
+    const entry& lookup(const sbox& box);
+    const entry& lookup(const bool_fn& fn);
+
+    // Persistence
+    void load();
+    void save() const;
+
+  private:
+    std::map<std::vector<size_type>, std::vector<size_type>> forms;    // {in, out, table} -> key in entries
+    mutable std::mutex lock;
+    static entry analyse(size_type in, size_type out, const std::vector<size_type>& table);
+};
+
+#endif
@@ -1,18 +1,10 @@
 // Implementations of the Trail class methods
 
 #include "trail.h"
+#include "trail_db.h"
 
 // Macro for std::abs
 #define FABS(x) (std::abs(x))
-#define RATE 0.01f
-#define PILING(x,y) (std::abs(2*x*y))
-#define PILING2(x,y,z) (std::abs(4*x*y*z))
-#define PILING3(x,y,z,w) (std::abs(8*x*y*z*w))
-
-// Global variable for debugging
-bool best = false;
-size_type comp1[] = {0, 0, 0, 0, 15, 0, 0, 0};
-size_type comp2[] = {4, 0, 0, 0, 0, 0, 0, 0};
 
 // Main Constructor
 trail::trail(const feistel& cipher)
@@ -52,14 +44,50 @@ trail::trail(const feistel& cipher)
    // Key Schedule
    round_sch = cipher.round_sch;
    key_size = cipher.key_size;
+   fingerprint = cipher.fingerprint();
+   verbose = false;
 
    // States
    curr_round_info = round_info();
-   curr_sbox_info = sbox_info();
+   nodes = 0;
+
+   // Search tables
+   mask_words = (stage_0 + bitstr::BITS_PER_BLOCK - 1) / bitstr::BITS_PER_BLOCK;
+   can_search = (stage_0 == stage_3) && (rf_after.if_minv || rf_after.if_pinv);
+   const std::vector<size_type>& inv_after = rf_after.if_minv ? rf_after.minv_table : rf_after.pinv_table;
+   sieved.resize(sboxes.size());
+   best_weight.resize(sboxes.size());
+   ip_spread.resize(sboxes.size());
+   op_spread.resize(sboxes.size());
+   op_source.resize(sboxes.size());
+   for (size_type i = 0; i < sboxes.size(); ++i) {
+     float scale = float(1 << (sbox_ip_sizes[i] + 1));
+     size_type out_mask = (size_type(1) << sbox_op_sizes[i]) - 1;
+     for (size_type op = 0; op <= out_mask; ++op) {
+       std::vector<lat_cand> cands;
+       for (const auto& entry : sboxes[i].sieve_lat(op)) {
+         float score = entry.second / scale;
+         cands.push_back({entry.first >> sbox_op_sizes[i], entry.first & out_mask, score, bias_weight(score)});
+       }
+       best_weight[i].push_back(cands.empty() ? WEIGHT_INF : cands[0].weight);
+       sieved[i].push_back(cands);
+     }
+     for (size_type ip = 0; ip < (size_type(1) << sbox_ip_sizes[i]); ++ip) {
+       bitstr half = std::get<0>(expand_lats(i, ip, 0));
+       ip_spread[i].insert(ip_spread[i].end(), half.blocks, half.blocks + mask_words);
+     }
+     for (size_type op = 0; op <= out_mask; ++op) {
+       bitstr half = std::get<1>(expand_lats(i, 0, op));
+       op_spread[i].insert(op_spread[i].end(), half.blocks, half.blocks + (stage_3 + bitstr::BITS_PER_BLOCK - 1) / bitstr::BITS_PER_BLOCK);
+     }
+     if (can_search) {
+       for (size_type j = 0; j < sbox_op_sizes[i]; ++j) op_source[i].push_back(inv_after[sbox_op_start[i] + j]);
+     }
+   }
 }
 
 // Evaluate bias for a vector
-float trail::eval_bias(std::vector<float> biases, size_type end)
+float trail::eval_bias(const std::vector<float>& biases, size_type end)
 {
   float res = 0.5f;
   for (size_type i = 0; i < end; ++i) res *= 2*biases[i];
@@ -146,6 +174,7 @@ void trail::first_three()
   auto save_1 = round_info();
   save_1.curr_round = 0;
   save_1.curr_bias = float(lat_entry.second) / (1 << (sboxes[best_sbox].input_size + 1));
+  save_1.curr_weight = bias_weight(save_1.curr_bias);
   save_1.ip_masks.push_back(ip);
   save_1.op_masks.push_back(op);
   save_1.key_masks.push_back(key);
@@ -165,6 +194,7 @@ void trail::first_three()
   auto save_3 = save_2;
   save_3.curr_round = 2;
   save_3.curr_bias = 2 * save_2.curr_bias * save_2.curr_bias;
+  save_3.curr_weight = 2 * save_2.curr_weight;
   save_3.ip_masks.push_back(save_2.ip_masks[0]);
   save_3.op_masks.push_back(save_2.op_masks[0]);
   save_3.key_masks.push_back(save_2.key_masks[0]);
@@ -176,320 +206,400 @@ void trail::first_three()
 }
 
 // Find a trail for more than three rounds
-void trail::more_than_three(size_type rounds)
+void trail::more_than_three(size_type rounds, size_type threads)
 {
-  std::cout << fin_trails.size() << " trails found for " << rounds - 1 << " rounds." << std::endl;
+  if (verbose) std::cout << fin_trails.size() << " trails found for " << rounds - 1 << " rounds." << std::endl;
   // Check if memo has size <rounds-1>
   if (fin_trails.size() != rounds-1) throw std::runtime_error("Memo vector size does not match necessary size.");
+  if (!can_search) throw std::runtime_error("Trail search needs equal half sizes and an invertible post S-Box permutation.");
+
+  // Starting bound: no trail is lighter than the pattern bound, nor than
+  // the best trail of one round less (the last round may be inactive)
+  if (pattern_bound.size() < rounds) pattern_search(rounds);
+  weight_type floor = std::max(pattern_bound[rounds - 1], fin_trails[rounds - 2].curr_weight);
+  weight_type ceiling = 0;
+  for (size_type size : sbox_ip_sizes) ceiling += rounds * size * WEIGHT_ONE;
+
+  // Search below the bound, raising it a bit of weight at a time until a
+  // trail turns up; the first one found is the best, whatever the start
+  size_type total_nodes = 0;
+  fin_trails.push_back(round_info());
+  for (weight_type limit = floor + 1; ; limit += WEIGHT_ONE) {
+    round_info new_round = round_info();
+    new_round.curr_weight = limit;
+    new_round.curr_bias = weight_bias(limit);
+    fin_trails[rounds - 1] = new_round;
+    search(rounds, (threads == 0) ? thread_count() : threads);
+    total_nodes += nodes;
+    if (!fin_trails[rounds - 1].biases.empty() || limit > ceiling) break;
+  }
+  nodes = total_nodes;
 
-  // Create an empty round_info and update its bias
-  round_info new_round = round_info();
-  new_round.curr_bias = RATE * fin_trails[rounds - 2].curr_bias;
-
-  // Push back to memo
-  fin_trails.push_back(new_round);
-
-  // Initialize curr_round_info
-  curr_round_info = round_info();
-
-  // Create vectors for input, output and key masks and biases of size "rounds"
-  curr_round_info.ip_masks = std::vector<bitstr>(rounds);
-  curr_round_info.op_masks = std::vector<bitstr>(rounds);
-  curr_round_info.key_masks = std::vector<bitstr>(rounds);
-  curr_round_info.biases = std::vector<float>(rounds);
-
-  // Call recursive function
-  more_than_three_one(rounds);
+  // Nothing below the ceiling: leave the memo as it was
+  if (fin_trails[rounds - 1].biases.empty()) {
+    fin_trails.pop_back();
+    throw std::runtime_error("No trail found for " + std::to_string(rounds) + " rounds.");
+  }
 }
 
-// Recursion steps
-// At round 1
-void trail::more_than_three_one(size_type rounds)
+// Pattern search
+// A truncated search over which S-Boxes are active, ignoring the masks
+// themselves. Half-block positions are grouped into words, one per S-Box
+// output (through rf_after), and S-Box i can only put input mask bits
+// into the words its rf_before sources lie in (reach). For round masks
+// v[r] = v[r-2] ^ u[r-1] a word of v[r] is active if exactly one of its
+// two terms is, may be if both are, and is not if neither is; u[r-1]
+// holds bits of every S-Box active in round r-1 and nothing beyond their
+// reach. Each active S-Box counts with its smallest weight, and the
+// minimum over all patterns is a lower bound on the weight of any trail.
+// Patterns of two consecutive rounds are the states of a dynamic program
+// over the rounds, with the states of one round spread over the threads.
+void trail::pattern_search(size_type rounds)
 {
-  // Check for every possible output-mask
-  for (auto it = sboxes.begin(); it != sboxes.end(); ++it) {
-    // Current SBox
-    size_type sbox_num = it - sboxes.begin();
-    size_type lim = (1 << it->output_size);
-    // Iterate over all possible output-masks
-    for (size_type op = 1; op < lim; ++op) {
-      if (op == 15 && sbox_num == 4) {
-        best = true;
-        std::cout << "SBox 4, Output Mask 15" << std::endl;
+  size_type nboxes = sboxes.size();
+  pattern_bound.assign(rounds, 0);
+  if (!can_search || nboxes > MAX_PATTERN_BOXES || rounds == 0) return;
+  size_type space = size_type(1) << nboxes;
+
+  // Smallest weight of an active S-Box, and the words it can reach
+  std::vector<weight_type> box_weight(nboxes, WEIGHT_INF);
+  std::vector<size_type> word_of(stage_0);
+  std::vector<size_type> reach(nboxes, 0);
+  for (size_type i = 0; i < nboxes; ++i) {
+    for (size_type op = 1; op < best_weight[i].size(); ++op) box_weight[i] = std::min(box_weight[i], best_weight[i][op]);
+    for (size_type src : op_source[i]) word_of[src] = i;
+  }
+  for (size_type i = 0; i < nboxes; ++i) {
+    for (size_type k = sbox_ip_start[i]; k < sbox_ip_start[i] + sbox_ip_sizes[i]; ++k) {
+      reach[i] |= size_type(1) << word_of[rf_before.main_table[k]];
+    }
+  }
+
+  // Per pattern: weight and reach; per (pattern, words): whether the words hit every S-Box
+  std::vector<weight_type> weight(space, 0);
+  std::vector<size_type> reach_of(space, 0);
+  for (size_type a = 0; a < space; ++a) {
+    for (size_type i = 0; i < nboxes; ++i) {
+      if ((a >> i) & 1) {
+        weight[a] = std::min(WEIGHT_INF, weight[a] + box_weight[i]);
+        reach_of[a] |= reach[i];
       }
-      else best = false;
-      // Best Sieve LAT-entry
-      auto lat_entry = it->sieve_lat(op)[0];
-      float score = lat_entry.second / float(1 << (it->input_size + 1));
-      // Check if better
-      if (PILING(score, fin_trails[rounds - 2].curr_bias) > FABS(fin_trails[rounds - 1].curr_bias)) {
-        // If best, print debug info
-        if (best) std::cout << "Going from 1 to 2" << std::endl;
-        // Expand the lat-entry
-        auto [ip, op_mask, key] = expand_lats(sbox_num, lat_entry.first >> it->output_size, 
-                                              lat_entry.first & ((1 << it->output_size) - 1));
-        // Temporarily store curr_round_info (to be replaced after recursion)
-        auto temp = curr_round_info;
-        // Update curr_round_info
-        curr_round_info.curr_round = 1;
-        curr_round_info.curr_bias = score;
-        curr_round_info.ip_masks[0] = ip;
-        curr_round_info.op_masks[0] = op_mask;
-        curr_round_info.key_masks[0] = key;
-        curr_round_info.biases[0] = score;
-        // Call recursion
-        more_than_three_two(rounds);
-        // Reset curr_round_info
-        curr_round_info = temp;
+    }
+  }
+  std::vector<uint8_t> hits(space * space, 1);
+  for (size_type a = 0; a < space; ++a) {
+    for (size_type y = 0; y < space; ++y) {
+      for (size_type i = 0; i < nboxes && hits[a * space + y]; ++i) {
+        if (((a >> i) & 1) && !(y & reach[i])) hits[a * space + y] = 0;
       }
     }
   }
 
-  // Reach here (no more candidates)
-  return;
+  // One round: any non-zero pattern
+  pattern_bound[0] = WEIGHT_INF;
+  for (size_type a = 1; a < space; ++a) pattern_bound[0] = std::min(pattern_bound[0], weight[a]);
+
+  // Two rounds: any pair of patterns, not both zero
+  std::vector<weight_type> cost(space * space), next(space * space);
+  for (size_type a = 0; a < space; ++a) {
+    for (size_type b = 0; b < space; ++b) cost[a * space + b] = (a | b) ? std::min(WEIGHT_INF, weight[a] + weight[b]) : WEIGHT_INF;
+  }
+  if (rounds > 1) pattern_bound[1] = *std::min_element(cost.begin(), cost.end());
+
+  // Further rounds: (a, b) -> (b, n) when some u within reach of b hits every
+  // S-Box of b, covers n ^ a and stays within n | a
+  for (size_type r = 2; r < rounds; ++r) {
+    std::fill(next.begin(), next.end(), WEIGHT_INF);
+    parallel_for(space, 1, [&](size_type beg, size_type end) {
+      for (size_type b = beg; b < end; ++b) {
+        for (size_type a = 0; a < space; ++a) {
+          weight_type here = cost[a * space + b];
+          if (here >= WEIGHT_INF) continue;
+          for (size_type n = 0; n < space; ++n) {
+            size_type widest = (n | a) & reach_of[b];
+            if (((n ^ a) & ~widest) || !hits[b * space + widest]) continue;
+            weight_type total = std::min(WEIGHT_INF, here + weight[n]);
+            if (total < next[b * space + n]) next[b * space + n] = total;
+          }
+        }
+      }
+    });
+    cost.swap(next);
+    pattern_bound[r] = *std::min_element(cost.begin(), cost.end());
+  }
 }
 
-// At round 2
-void trail::more_than_three_two(size_type rounds)
+// Search engine
+// The search is a depth-first branch and bound over (round, S-Box) frames,
+// run with an explicit stack: every frame keeps its cursor into its sieved
+// LAT list, and choosing a candidate only overwrites the frame, so nothing
+// is copied or restored on the way back. Candidates come sorted by |bias|
+// and the bound only tightens, so a frame stops at its first failure.
+// Within a round the output mask is fixed on entry, so the S-Boxes not yet
+// chosen are already known to be active and their smallest weight
+// (best_weight) is added to the bound of every earlier frame.
+//
+// Bounds are compared as weights (see weight.h): piling up is a sum and
+// every comparison is an exact integer one. The biases of a trail are only
+// multiplied out, with their signs, when it is stored.
+//
+// Every choice of rounds 0 and 1 is an independent subtree (round 0 alone
+// gives only a handful, which leaves workers idle behind the big ones).
+// The subtrees are listed in sequential order and workers take the next
+// one from a shared counter; the best weight so far is one atomic that all
+// of them prune against, and a new best trail is stored under a lock. With one worker this is exactly
+// the sequential search; with more, trails of equal weight may be found in
+// a different order.
+
+// Fix the output mask of a round (op_masks[r-2] ^ ip_masks[r-1]) and its S-Box slices
+void trail::enter_round(search_state& st, size_type round) const
 {
-  // Iterate through every S-Box
-  for(auto it = sboxes.begin(); it != sboxes.end(); ++it) {
-    // Current SBox
-    size_type sbox_num = it - sboxes.begin();
-    // Iterate through all LAT entries
-    for (auto lat_it = it->lat.begin(); lat_it != it->lat.end(); ++lat_it) {
-      // Get score
-      float score = lat_it->second / float(1 << (it->input_size + 1));
-      // Debugging
-      if (best && lat_it->first == 0) {
-        best = true;
-      }
-      else {
-        best = false;
-      }
-      // Check if better
-      if (PILING2(curr_round_info.curr_bias, score, fin_trails[rounds - 3].curr_bias) > FABS(fin_trails[rounds - 1].curr_bias)) {
-        if (best) std::cout << "Going from 2 to 3" << std::endl;
-        // Expand the lat-entry
-        auto [ip, op_mask, key] = expand_lats(sbox_num, lat_it->first >> it->output_size, 
-                                              lat_it->first & ((1 << it->output_size) - 1));
-        // Temporarily store curr_round_info (to be replaced after recursion)
-        auto temp = curr_round_info;
-        // Update curr_round_info
-        curr_round_info.curr_round = 2;
-        curr_round_info.curr_bias = PILING(score, curr_round_info.curr_bias);
-        curr_round_info.ip_masks[1] = ip;
-        curr_round_info.op_masks[1] = op_mask;
-        curr_round_info.key_masks[1] = key;
-        curr_round_info.biases[1] = score;
-        // Call recursion
-        more_than_three_intermediate(rounds);
-        // Reset curr_round_info
-        curr_round_info = temp;
-      }
+  size_type nboxes = sboxes.size();
+  block_type* fixed = st.op_words.data() + round * mask_words;
+  const block_type* op_prev = st.op_words.data() + (round - 2) * mask_words;
+  const block_type* ip_prev = st.ip_words.data() + (round - 1) * mask_words;
+  for (size_type w = 0; w < mask_words; ++w) fixed[w] = op_prev[w] ^ ip_prev[w];
+
+  for (size_type i = 0; i < nboxes; ++i) {
+    frame& f = st.frames[round * nboxes + i];
+    f.cursor = 0;
+    f.op = 0;
+    for (size_type src : op_source[i]) {
+      f.op = (f.op << 1) | ((fixed[src / bitstr::BITS_PER_BLOCK] >> (src % bitstr::BITS_PER_BLOCK)) & 1);
     }
   }
-  // Reach here (no more candidates)
-  return;
+  st.frames[round * nboxes].weight = 0;
+
+  // Lookahead: the S-Boxes after a frame add at least their smallest weight
+  weight_type ahead = 0;
+  for (size_type i = nboxes; i-- > 0;) {
+    frame& f = st.frames[round * nboxes + i];
+    f.ahead = ahead;
+    ahead = std::min(WEIGHT_INF, ahead + best_weight[i][f.op]);
+  }
 }
 
-// At round i > 2 (but not the last round)
-void trail::more_than_three_intermediate(size_type rounds) {
-  // Fix output masks
-  bitstr fixed_op_mask = curr_round_info.op_masks[curr_round_info.curr_round - 2] ^
-                          curr_round_info.ip_masks[curr_round_info.curr_round - 1];
-  bitstr inv_op_mask = fixed_op_mask.inv_permute(rf_after);
-
-  // Make a s-box state
-  curr_sbox_info = sbox_info();
-
-  // Create vectors for input, output and biases of size "sboxes.size()"
-  curr_sbox_info.ip_masks = std::vector<size_type>(sboxes.size());
-  curr_sbox_info.op_masks = std::vector<size_type>(sboxes.size());
-  curr_sbox_info.biases = std::vector<float>(sboxes.size());
-
-  // Call recursive function
-  more_than_three_intermediate_sbox(rounds, inv_op_mask);
-  return;
+// Input mask and weight of a round once all of its S-Boxes are chosen
+void trail::leave_round(search_state& st, size_type round, weight_type weight) const
+{
+  size_type nboxes = sboxes.size();
+  block_type* ip = st.ip_words.data() + round * mask_words;
+  std::fill(ip, ip + mask_words, 0);
+  for (size_type i = 0; i < nboxes; ++i) {
+    const block_type* spread = ip_spread[i].data() + st.frames[round * nboxes + i].ip * mask_words;
+    for (size_type w = 0; w < mask_words; ++w) ip[w] |= spread[w];
+  }
+  st.piled_weight[round] = st.piled_weight[round - 1] + weight;
 }
 
-// At round i > 2 (but not the last round) for each sbox
-void trail::more_than_three_intermediate_sbox(size_type rounds, bitstr op_mask) {
-  // Get slice
-  size_type op = op_mask.value(sbox_op_start[curr_sbox_info.curr_box], 
-                               sbox_op_start[curr_sbox_info.curr_box] + sbox_op_sizes[curr_sbox_info.curr_box]); 
-  // Get sieved entries
-  auto entries = sboxes[curr_sbox_info.curr_box].sieve_lat(op);
-  for (auto it = entries.begin(); it != entries.end(); ++it) {
-    // Get score
-    float score = it->second / float(1 << (sboxes[curr_sbox_info.curr_box].input_size + 1));
-    // Debugging
-    if (best && comp1[curr_sbox_info.curr_box] == (it->first & ((1 << sboxes[curr_sbox_info.curr_box].output_size) - 1))) {
-      best = true;
+// The current trail of a worker as a round_info
+trail::round_info trail::found_trail(const search_state& st, size_type rounds) const
+{
+  size_type nboxes = sboxes.size();
+  round_info found = round_info();
+  found.curr_round = rounds - 1;
+  found.curr_weight = st.piled_weight[rounds - 1];
+  double total = 0.5;
+  for (size_type r = 0; r < rounds; ++r) {
+    bitstr ip(stage_0), op(stage_3), key(stage_1);
+    std::copy(st.ip_words.begin() + r * mask_words, st.ip_words.begin() + (r + 1) * mask_words, ip.blocks);
+    std::copy(st.op_words.begin() + r * mask_words, st.op_words.begin() + (r + 1) * mask_words, op.blocks);
+    double bias = 0.5;
+    for (size_type i = 0; i < nboxes; ++i) {
+      key(sbox_ip_start[i], sbox_ip_start[i] + sbox_ip_sizes[i]) |= block_type(st.frames[r * nboxes + i].ip);
+      bias *= 2 * st.frames[r * nboxes + i].score;
     }
-    else {
-      best = false;
+    found.ip_masks.push_back(ip);
+    found.op_masks.push_back(op);
+    found.key_masks.push_back(key);
+    found.biases.push_back(float(bias));
+    total *= 2 * bias;
+  }
+  found.curr_bias = float(total);
+  return found;
+}
+
+void trail::search(size_type rounds, size_type threads)
+{
+  size_type nboxes = sboxes.size();
+  std::vector<weight_type> rest(rounds);      // rest[k]: weight of the best (k + 1)-round trail
+  for (size_type k = 0; k + 1 < rounds; ++k) rest[k] = fin_trails[k].curr_weight;
+  std::atomic<weight_type> bound(fin_trails[rounds - 1].curr_weight);
+  std::mutex lock;
+
+  // Round 1 candidates: any S-Box LAT entry, in order of |bias|
+  std::vector<std::vector<lat_cand>> round1(nboxes);
+  for (size_type box1 = 0; box1 < nboxes; ++box1) {
+    size_type out_mask = (size_type(1) << sbox_op_sizes[box1]) - 1;
+    float scale = float(1 << (sbox_ip_sizes[box1] + 1));
+    for (const auto& entry : sboxes[box1].lat) {
+      float score = entry.second / scale;
+      round1[box1].push_back({entry.first >> sbox_op_sizes[box1], entry.first & out_mask, score, bias_weight(score)});
     }
-    // Check if better
-    if (PILING3(curr_round_info.curr_bias, score, curr_sbox_info.curr_bias, 
-                fin_trails[rounds - 2 - curr_round_info.curr_round].curr_bias) > 
-        FABS(fin_trails[rounds - 1].curr_bias)) {
-      // If best, print debug info
-      if (best) std::cout << "In recursion 3 for sbox " << curr_sbox_info.curr_box << std::endl;
-      // Store current sbox info
-      auto temp_s = curr_sbox_info;
-      // Update current sbox info
-      curr_sbox_info.ip_masks[curr_sbox_info.curr_box] = it->first >> sboxes[curr_sbox_info.curr_box].output_size;
-      curr_sbox_info.op_masks[curr_sbox_info.curr_box] = it->first & ((1 << sboxes[curr_sbox_info.curr_box].output_size) - 1);
-      curr_sbox_info.biases[curr_sbox_info.curr_box] = score;
-      curr_sbox_info.curr_bias = eval_bias(curr_sbox_info.biases, curr_sbox_info.curr_box + 1);
-      // Check if we reached the last sbox
-      if (curr_sbox_info.curr_box + 1 < sboxes.size()) {
-        // Increment current sbox
-        curr_sbox_info.curr_box++;
-        // Call recursion
-        more_than_three_intermediate_sbox(rounds, op_mask);
-        // Reset current sbox info
-        curr_sbox_info = temp_s;
-      } else {
-        // Determine key-mask
-        bitstr key_mask_bits = bitstr(stage_1);
-        for (size_type i = 0; i < sboxes.size(); ++i) {
-          key_mask_bits(sbox_ip_start[i], sbox_ip_start[i] + sbox_ip_sizes[i]) |= 
-            block_type(curr_sbox_info.ip_masks[i]);
-        }
-        // Determine input-mask
-        bitstr input_mask_bits = key_mask_bits.sinv_permute(rf_before);
-        // Store current round info
-        auto temp_r = curr_round_info;
-        // Update current round info
-        curr_round_info.ip_masks[curr_round_info.curr_round] = input_mask_bits;
-        curr_round_info.op_masks[curr_round_info.curr_round] = op_mask;
-        curr_round_info.key_masks[curr_round_info.curr_round] = key_mask_bits;
-        curr_round_info.biases[curr_round_info.curr_round] = curr_sbox_info.curr_bias;
-        curr_round_info.curr_bias = PILING(curr_round_info.curr_bias, curr_sbox_info.curr_bias);
-        curr_round_info.curr_round = curr_round_info.curr_round + 1;
-        // Check if we are at the penultimate round
-        if (curr_round_info.curr_round < rounds - 1) {
-          more_than_three_intermediate(rounds);
-          curr_round_info = temp_r;
-          curr_sbox_info = temp_s;
-        }
-        else {
-          more_than_three_final(rounds);
-          curr_round_info = temp_r;
-          curr_sbox_info = temp_s;
+  }
+
+  // Subtrees: a round 0 choice (the best entry of an S-Box output mask) and
+  // a round 1 entry, in sequential order; those failing the starting bound
+  // are left out, as the bound only gets tighter
+  struct subtree
+  {
+    size_type box0, op0, box1, entry1;
+  };
+  std::vector<subtree> subtrees;
+  for (size_type box0 = 0; box0 < nboxes; ++box0) {
+    for (size_type op0 = 1; op0 < sieved[box0].size(); ++op0) {
+      weight_type piled = sieved[box0][op0][0].weight;
+      if (!(piled + rest[rounds - 2] < bound.load())) continue;
+      for (size_type box1 = 0; box1 < nboxes; ++box1) {
+        for (size_type e = 0; e < round1[box1].size(); ++e) {
+          if (!(piled + round1[box1][e].weight + rest[rounds - 3] < bound.load())) break;
+          subtrees.push_back({box0, op0, box1, e});
         }
       }
     }
   }
-  // Reach here (no more candidates)
-  return;
-}
-
-// At last round
-void trail::more_than_three_final(size_type rounds) {
-  // Fix output masks
-  bitstr fixed_op_mask = curr_round_info.op_masks[curr_round_info.curr_round - 2] ^
-                          curr_round_info.ip_masks[curr_round_info.curr_round - 1];
-  bitstr inv_op_mask = fixed_op_mask.inv_permute(rf_after);
-
-  // Make a s-box state
-  curr_sbox_info = sbox_info();
 
-  // Create vectors for input, output and biases of size "sboxes.size()"
-  curr_sbox_info.ip_masks = std::vector<size_type>(sboxes.size());
-  curr_sbox_info.op_masks = std::vector<size_type>(sboxes.size());
-  curr_sbox_info.biases = std::vector<float>(sboxes.size());
-
-  // Call recursive function
-  more_than_three_final_sbox(rounds, inv_op_mask);
-  return;
-}
+  // Place a single S-Box approximation as round 0 or 1
+  auto place = [&](search_state& st, size_type round, size_type box, const lat_cand& c) {
+    for (size_type i = 0; i < nboxes; ++i) {
+      st.frames[round * nboxes + i].ip = 0;
+      st.frames[round * nboxes + i].score = 0.5f;
+    }
+    st.frames[round * nboxes + box].ip = c.ip;
+    st.frames[round * nboxes + box].score = c.score;
+    std::copy_n(ip_spread[box].begin() + c.ip * mask_words, mask_words, st.ip_words.begin() + round * mask_words);
+    std::copy_n(op_spread[box].begin() + c.op * mask_words, mask_words, st.op_words.begin() + round * mask_words);
+  };
+
+  // Rounds 2 .. rounds - 1, S-Box by S-Box
+  auto deepen = [&](search_state& st) {
+    size_type r = 2, b = 0;
+    enter_round(st, 2);
+    while (true) {
+      frame& f = st.frames[r * nboxes + b];
+      const std::vector<lat_cand>& list = sieved[b][f.op];
+      bool last = (r == rounds - 1);
+      size_type limit = last ? 1 : list.size();      // the last round only takes the best entry
+      weight_type fixed = st.piled_weight[r - 1] + f.weight + f.ahead + (last ? 0 : rest[rounds - 2 - r]);
+      bool descended = false;
+      while (f.cursor < limit) {
+        const lat_cand& c = list[f.cursor++];
+        ++st.nodes;
+        if (!(fixed + c.weight < bound.load(std::memory_order_relaxed))) {
+          f.cursor = limit;
+          break;
+        }
+        f.ip = c.ip;
+        f.score = c.score;
+        weight_type piled = f.weight + c.weight;
+        if (b + 1 < nboxes) {
+          frame& next = st.frames[r * nboxes + b + 1];
+          next.cursor = 0;
+          next.weight = piled;
+          ++b;
+          descended = true;
+          break;
+        }
+        leave_round(st, r, piled);
+        if (last) {
+          // New best: store it, then tighten the shared bound (reported
+          // outside the lock)
+          float improved = 0;
+          {
+            std::lock_guard<std::mutex> guard(lock);
+            if (st.piled_weight[r] < bound.load()) {
+              fin_trails[rounds - 1] = found_trail(st, rounds);
+              improved = fin_trails[rounds - 1].curr_bias;
+              bound.store(st.piled_weight[r]);
+            }
+          }
+          if (verbose && improved != 0) std::cout << "BIAS UPDATE: " << improved << std::endl;
+          continue;
+        }
+        enter_round(st, ++r);
+        b = 0;
+        descended = true;
+        break;
+      }
+      if (descended) continue;
 
-// At last round for each sbox
-void trail::more_than_three_final_sbox(size_type rounds, bitstr op_mask) {
-  // Get slice
-  size_type op = op_mask.value(sbox_op_start[curr_sbox_info.curr_box], 
-                               sbox_op_start[curr_sbox_info.curr_box] + sbox_op_sizes[curr_sbox_info.curr_box]); 
-  // Get top sieve-entry
-  auto lat_entry = sboxes[curr_sbox_info.curr_box].sieve_lat(op)[0];
-  // Get score
-  float score = lat_entry.second / float(1 << (sboxes[curr_sbox_info.curr_box].input_size + 1));
-  // Debugging
-  if (best && comp2[curr_sbox_info.curr_box] == (lat_entry.first & ((1 << sboxes[curr_sbox_info.curr_box].output_size) - 1))) {
-    best = true;
-  }
-  else {
-    best = false;
-  }
-  // Check if better
-  if (PILING2(curr_round_info.curr_bias, score, curr_sbox_info.curr_bias) > 
-        FABS(fin_trails[rounds - 1].curr_bias)) {
-    // If best, print debug info
-    if (best) std::cout << "In recursion 4 for sbox " << curr_sbox_info.curr_box << std::endl;
-    // Store current sbox info
-    auto temp_s = curr_sbox_info;
-    // Update current sbox info
-    curr_sbox_info.ip_masks[curr_sbox_info.curr_box] = lat_entry.first >> sboxes[curr_sbox_info.curr_box].output_size;
-    curr_sbox_info.op_masks[curr_sbox_info.curr_box] = lat_entry.first & ((1 << sboxes[curr_sbox_info.curr_box].output_size) - 1);
-    curr_sbox_info.biases[curr_sbox_info.curr_box] = score;
-    curr_sbox_info.curr_bias = eval_bias(curr_sbox_info.biases, curr_sbox_info.curr_box + 1);
-    // Check if we reached the last sbox
-    if (curr_sbox_info.curr_box + 1 < sboxes.size()) {
-      // Increment current sbox
-      curr_sbox_info.curr_box++;
-      // Call recursion
-      more_than_three_final_sbox(rounds, op_mask);
-      // Reset current sbox info
-      curr_sbox_info = temp_s;
-    } else {
-      // Determine key-mask
-      bitstr key_mask_bits = bitstr(stage_1);
-      for (size_type i = 0; i < sboxes.size(); ++i) {
-        key_mask_bits(sbox_ip_start[i], sbox_ip_start[i] + sbox_ip_sizes[i]) |= 
-          block_type(curr_sbox_info.ip_masks[i]);
+      // Frame exhausted: back to the previous S-Box or round
+      if (b > 0) --b;
+      else if (r > 2) {
+        --r;
+        b = nboxes - 1;
       }
-      // Determine input-mask
-      bitstr input_mask_bits = key_mask_bits.sinv_permute(rf_before);
-      // Store current round info
-      auto temp_r = curr_round_info;
-      // Update current round info
-      curr_round_info.ip_masks[curr_round_info.curr_round] = input_mask_bits;
-      curr_round_info.op_masks[curr_round_info.curr_round] = op_mask;
-      curr_round_info.key_masks[curr_round_info.curr_round] = key_mask_bits;
-      curr_round_info.biases[curr_round_info.curr_round] = curr_sbox_info.curr_bias;
-      curr_round_info.curr_bias = PILING(curr_round_info.curr_bias, curr_sbox_info.curr_bias);
-      std::cout << "BIAS UPDATE: " << curr_round_info.curr_bias << std::endl;
-      // Add to final trails and biases
-      fin_trails[rounds - 1] = curr_round_info;
-      // Reset current info
-      curr_round_info = temp_r;
-      curr_sbox_info = temp_s;
+      else break;
     }
-  }
-  // Reach here (no more candidates)
-  return;
+  };
+
+  // Search one subtree (the live bound may have passed it since it was listed)
+  auto explore = [&](search_state& st, const subtree& t) {
+    const lat_cand& c0 = sieved[t.box0][t.op0][0];
+    const lat_cand& c1 = round1[t.box1][t.entry1];
+    ++st.nodes;
+    weight_type live = bound.load(std::memory_order_relaxed);
+    if (!(c0.weight + rest[rounds - 2] < live) || !(c0.weight + c1.weight + rest[rounds - 3] < live)) return;
+    place(st, 0, t.box0, c0);
+    st.piled_weight[0] = c0.weight;
+    place(st, 1, t.box1, c1);
+    st.piled_weight[1] = st.piled_weight[0] + c1.weight;
+    deepen(st);
+  };
+
+  // Workers take subtrees in order from a shared counter
+  std::atomic<size_type> next(0);
+  std::atomic<size_type> total_nodes(0);
+  auto worker = [&]() {
+    search_state st;
+    st.frames.assign(rounds * nboxes, frame{0, 0, 0, 0.5f, 0, 0});
+    st.ip_words.assign(rounds * mask_words, 0);
+    st.op_words.assign(rounds * mask_words, 0);
+    st.piled_weight.assign(rounds, 0);
+    st.nodes = 0;
+    for (size_type t = next++; t < subtrees.size(); t = next++) explore(st, subtrees[t]);
+    total_nodes += st.nodes;
+  };
+  threads = std::max<size_type>(1, std::min(threads, subtrees.size()));
+  std::vector<std::thread> pool;
+  for (size_type i = 1; i < threads; ++i) pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool) t.join();
+  nodes = total_nodes;
 }
 
 // Upto n trails
-void trail::upto(size_type rounds) {
-  // Check if rounds is n0.0190735ot more than max_rounds
+void trail::upto(size_type rounds, size_type threads) {
+  // Check if rounds is not more than max_rounds
   if (rounds > max_rounds) {
     throw std::runtime_error("Number of rounds exceeds maximum rounds.");
   }
-  // Check if rounds is less than/ equal to 3
-  first_three();
+  pattern_search(rounds);
+  // Check if rounds is less than/ equal to 3 (rounds already in the memo are kept)
+  if (fin_trails.size() < 3) first_three();
   if (rounds <= 3) {
     return;
   }
   else {
-    for (size_type i = 4; i <= rounds; ++i) more_than_three(i);
+    for (size_type i = std::max<size_type>(4, fin_trails.size() + 1); i <= rounds; ++i) more_than_three(i, threads);
     return;
   }
   return;
 }
 
+// Load from a trail store
+void trail::load(const trail_db& db)
+{
+  if (db.fingerprint != fingerprint) {
+    throw std::invalid_argument("Trail store belongs to another cipher.");
+  }
+  // Only a run of round counts from 1 can seed the memo
+  fin_trails.clear();
+  for (size_type r = 1; r <= std::min(db.max_rounds(), max_rounds) && db.count(r) > 0; ++r) {
+    fin_trails.push_back(db.get(r));
+  }
+}
+
 // Get trail masks
 std::tuple<bitstr, bitstr, bitstr> trail::trail_masks(size_type rounds) {
   // Checks
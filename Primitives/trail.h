@@ -15,6 +15,8 @@
 #include "sbox.h"
 #include "bitstr.h"
 #include "perm.h"
+#include "parallel.h"
+#include "weight.h"
 
 // Mains
 #include <iostream>
@@ -23,6 +25,12 @@
 #include <stdexcept>
 #include <cstdlib>
 #include <cmath>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Persistent trail store (trail_db.h)
+class trail_db;
 
 // Main Class
 class trail
@@ -65,6 +73,7 @@ class trail
     // Current Stuff
     size_type curr_round;
     float curr_bias;
+    weight_type curr_weight;        // of curr_bias, which the searches compare
 
     // Default Constructor
     round_info() {
@@ -77,6 +86,7 @@ class trail
       // Initialize current round and bias
       curr_round = 0;
       curr_bias = 0.5f;
+      curr_weight = 0;
     }
   };
   round_info curr_round_info;
@@ -107,7 +117,6 @@ class trail
       curr_bias = 0.5f;
     }
   };
-  sbox_info curr_sbox_info;
 
   // Overall Information
   std::vector<round_info> fin_trails;
@@ -116,32 +125,87 @@ class trail
   // Import key-schedule from cipher
   std::vector<std::vector<size_type>> round_sch;
   size_type key_size;
+  uint64_t fingerprint;
 
   // Constructor
   trail(const feistel& cipher);
 
+  // Search nodes (S-Box choices tried) of the last more_than_three
+  size_type nodes;
+
+  // Report progress (rounds done, each better trail) on std::cout
+  bool verbose;
+
+  // Lower bounds on trail weights (entry r - 1: r rounds) from S-Box
+  // activity patterns; all 0 when there are too many S-Boxes to enumerate
+  std::vector<weight_type> pattern_bound;
+
   // Helpers
-  float eval_bias(std::vector<float> biases, size_type end);
+  float eval_bias(const std::vector<float>& biases, size_type end);
   void print_round_info(const round_info& rinfo);
   void print_sbox_info(const sbox_info& sinfo);
   std::tuple<bitstr, bitstr, bitstr> expand_lats(size_type sbox_num, size_type ip_mask, size_type op_mask);
 
   // Routines
   void first_three();
-  void more_than_three(size_type rounds);
-  void upto(size_type rounds);
+  // threads: workers for the searches beyond three rounds (0: all hardware threads);
+  // throws if no trail exists, leaving the memo at the rounds already found
+  void more_than_three(size_type rounds, size_type threads = 1);
+  void upto(size_type rounds, size_type threads = 1);
+  void pattern_search(size_type rounds);
 
-  // Sub-routines
-  void more_than_three_one(size_type rounds);
-  void more_than_three_two(size_type rounds);
-  void more_than_three_intermediate(size_type rounds);
-  void more_than_three_intermediate_sbox(size_type rounds, bitstr op_mask);
-  void more_than_three_final(size_type rounds);
-  void more_than_three_final_sbox(size_type rounds, bitstr op_mask);
+  // Take the best known trails of the cipher from a store, so that upto
+  // only searches the rounds beyond them
+  void load(const trail_db& db);
 
   // Trail Masks
   std::tuple<bitstr, bitstr, bitstr> trail_masks(size_type rounds);
   bitstr sub_trail_masks(size_type rounds);         /* Finds key-mask for last round alone!:*/
+
+  private:
+  static constexpr size_type MAX_PATTERN_BOXES = 8;
+
+  // Search tables, built once by the constructor. Masks are kept as raw
+  // bitstr words (mask_words per half) so the search never allocates.
+  struct lat_cand
+  {
+    size_type ip;
+    size_type op;
+    float score;
+    weight_type weight;
+  };
+  size_type mask_words;
+  bool can_search;                                  // rf_after has an inverse
+  std::vector<std::vector<std::vector<lat_cand>>> sieved;  // [sbox][output mask], as sieve_lat orders them
+  std::vector<std::vector<weight_type>> best_weight;  // [sbox][output mask]: smallest weight
+  std::vector<std::vector<block_type>> ip_spread;   // [sbox]: input mask -> half mask (words)
+  std::vector<std::vector<block_type>> op_spread;   // [sbox]: output mask -> half mask (words)
+  std::vector<std::vector<size_type>> op_source;    // [sbox]: half bit feeding each output mask bit
+
+  // Frames of one worker (rounds x sboxes) and the masks they imply
+  struct frame
+  {
+    size_type cursor;     // next candidate
+    size_type op;         // output mask of this S-Box
+    size_type ip;         // chosen input mask
+    float score;          // bias of the chosen entry
+    weight_type weight;   // weight of the S-Boxes before this one
+    weight_type ahead;    // smallest weight of the S-Boxes after it
+  };
+  struct search_state
+  {
+    std::vector<frame> frames;
+    std::vector<block_type> ip_words;
+    std::vector<block_type> op_words;
+    std::vector<weight_type> piled_weight;
+    size_type nodes;
+  };
+
+  // Search helpers
+  void enter_round(search_state& st, size_type round) const;
+  void leave_round(search_state& st, size_type round, weight_type weight) const;
+  round_info found_trail(const search_state& st, size_type rounds) const;
+  void search(size_type rounds, size_type threads);
 };
 
 #endif
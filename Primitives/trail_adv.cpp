@@ -5,12 +5,13 @@
 // Macro for std::abs
 #define FABS(x) (std::abs(x))
 #define RATE 0.01f
-#define PILING(x,y) (std::abs(2*x*y))
-#define PILING2(x,y,z) (std::abs(4*x*y*z))
-#define PILING3(x,y,z,w) (std::abs(8*x*y*z*w))
 #define GET(x, arr) std::get<x>(arr)
 #define EPSILON 0.00f
 
+// Weights are piled up as integer sums (see weight.h): a candidate is kept
+// when the sum of its weights stays below the bar, and trails are ranked
+// by weight. Biases are only multiplied out for the record.
+
 // Helper function to insert a pair into a vector while maintaining size
 void place_b(std::vector<std::tuple<size_type, size_type, short_type>> &arr, std::tuple<size_type, size_type, short_type> entry) {
   bool inject = false;
@@ -55,7 +56,7 @@ void trail_adv::place(std::vector<round_info> &arr, round_info entry) {
   bool inject = false;
   for (auto it = arr.begin(); it != arr.end(); ++it) {
     if (is_equal(entry, *it)) return;         // No insertions!
-    if (FABS(entry.curr_bias) >= FABS(it->curr_bias)) {
+    if (entry.curr_weight <= it->curr_weight) {
       arr.insert(it, entry);
       inject = true;
       break;
@@ -110,6 +111,7 @@ trail_adv::trail_adv(const feistel& cipher)
    // Key Schedule
    round_sch = cipher.round_sch;
    key_size = cipher.key_size;
+   fingerprint = cipher.fingerprint();
 
    // States
    curr_round_info = round_info();
@@ -124,6 +126,12 @@ float trail_adv::eval_bias(std::vector<float> biases, size_type end)
   return res;
 }
 
+// Weight of the last trail kept for a number of rounds
+weight_type trail_adv::memo_bound(size_type rounds) const
+{
+  return fin_trails[rounds - 1].back().curr_weight;
+}
+
 // Print round-info
 void trail_adv::print_round_info(const round_info& rinfo)
 {
@@ -213,6 +221,7 @@ void trail_adv::first_three()
     auto save_1 = round_info();
     save_1.curr_round = 0;
     save_1.curr_bias = float(GET(2, *it)) / (1 << (sboxes[GET(0, *it)].input_size + 1));
+    save_1.curr_weight = bias_weight(save_1.curr_bias);
     save_1.ip_masks.push_back(ip);
     save_1.op_masks.push_back(op);
     save_1.key_masks.push_back(key);
@@ -242,6 +251,7 @@ void trail_adv::first_three()
     auto save_3 = *it;
     save_3.curr_round = 2;
     save_3.curr_bias = 2 * it->curr_bias * it->curr_bias;
+    save_3.curr_weight = 2 * it->curr_weight;
     save_3.ip_masks.push_back(it->ip_masks[0]);
     save_3.op_masks.push_back(it->op_masks[0]);
     save_3.key_masks.push_back(it->key_masks[0]);
@@ -261,9 +271,11 @@ void trail_adv::more_than_three(size_type rounds)
   // Check if memo has size <rounds-1>
   if (fin_trails.size() != rounds-1) throw std::runtime_error("Memo vector size does not match necessary size.");
 
-  // Create an empty round_info and update its bias
+  // Create an empty round_info as the starting bar (RATE times the bias of
+  // the last trail kept for one round less)
   round_info test = round_info();
-  test.curr_bias = RATE * fin_trails[rounds - 2][MEMO_SIZE - 1].curr_bias;
+  test.curr_weight = memo_bound(rounds - 1) + bias_weight(RATE / 2);
+  test.curr_bias = float(weight_bias(test.curr_weight));
   std::vector<round_info> new_round;
   new_round.push_back(test);
 
@@ -281,6 +293,15 @@ void trail_adv::more_than_three(size_type rounds)
 
   // Call recursive function
   more_than_three_one(rounds);
+
+  // Drop the bar unless nothing beat it
+  std::vector<round_info>& found = fin_trails[rounds - 1];
+  found.erase(std::remove_if(found.begin(), found.end(), [&](const round_info& t) { return t.biases.size() != rounds; }),
+              found.end());
+  if (found.empty()) {
+    fin_trails.pop_back();
+    throw std::runtime_error("No trail found for " + std::to_string(rounds) + " rounds.");
+  }
 }
 
 // Recursion steps
@@ -297,8 +318,9 @@ void trail_adv::more_than_three_one(size_type rounds)
       // Best Sieve LAT-entry
       auto lat_entry = it->sieve_lat(op)[0];
       float score = lat_entry.second / float(1 << (it->input_size + 1));
+      weight_type weight = bias_weight(score);
       // Check if better
-      if (PILING(score, fin_trails[rounds - 2][MEMO_SIZE - 1].curr_bias) > FABS(fin_trails[rounds - 1][MEMO_SIZE - 1].curr_bias)) {
+      if (weight + memo_bound(rounds - 1) < memo_bound(rounds)) {
         // Expand the lat-entry
         auto [ip, op_mask, key] = expand_lats(sbox_num, lat_entry.first >> it->output_size, 
                                               lat_entry.first & ((1 << it->output_size) - 1));
@@ -307,6 +329,7 @@ void trail_adv::more_than_three_one(size_type rounds)
         // Update curr_round_info
         curr_round_info.curr_round = 1;
         curr_round_info.curr_bias = score;
+        curr_round_info.curr_weight = weight;
         curr_round_info.ip_masks[0] = ip;
         curr_round_info.op_masks[0] = op_mask;
         curr_round_info.key_masks[0] = key;
@@ -334,8 +357,9 @@ void trail_adv::more_than_three_two(size_type rounds)
     for (auto lat_it = it->lat.begin(); lat_it != it->lat.end(); ++lat_it) {
       // Get score
       float score = lat_it->second / float(1 << (it->input_size + 1));
+      weight_type weight = bias_weight(score);
       // Check if better
-      if (PILING2(curr_round_info.curr_bias, score, fin_trails[rounds - 3][MEMO_SIZE - 1].curr_bias) > FABS(fin_trails[rounds - 1][MEMO_SIZE - 1].curr_bias)) {
+      if (curr_round_info.curr_weight + weight + memo_bound(rounds - 2) < memo_bound(rounds)) {
         // Expand the lat-entry
         auto [ip, op_mask, key] = expand_lats(sbox_num, lat_it->first >> it->output_size, 
                                               lat_it->first & ((1 << it->output_size) - 1));
@@ -343,7 +367,8 @@ void trail_adv::more_than_three_two(size_type rounds)
         auto temp = curr_round_info;
         // Update curr_round_info
         curr_round_info.curr_round = 2;
-        curr_round_info.curr_bias = PILING(score, curr_round_info.curr_bias);
+        curr_round_info.curr_bias = 2 * score * curr_round_info.curr_bias;
+        curr_round_info.curr_weight += weight;
         curr_round_info.ip_masks[1] = ip;
         curr_round_info.op_masks[1] = op_mask;
         curr_round_info.key_masks[1] = key;
@@ -389,10 +414,10 @@ void trail_adv::more_than_three_intermediate_sbox(size_type rounds, bitstr op_ma
   for (auto it = entries.begin(); it != entries.end(); ++it) {
     // Get score
     float score = it->second / float(1 << (sboxes[curr_sbox_info.curr_box].input_size + 1));
+    weight_type weight = bias_weight(score);
     // Check if better
-    if (PILING3(curr_round_info.curr_bias, score, curr_sbox_info.curr_bias, 
-                fin_trails[rounds - 2 - curr_round_info.curr_round][MEMO_SIZE - 1].curr_bias) > 
-        FABS(fin_trails[rounds - 1][MEMO_SIZE - 1].curr_bias)) {
+    if (curr_round_info.curr_weight + weight + curr_sbox_info.curr_weight +
+        memo_bound(rounds - 1 - curr_round_info.curr_round) < memo_bound(rounds)) {
       // Store current sbox info
       auto temp_s = curr_sbox_info;
       // Update current sbox info
@@ -400,6 +425,7 @@ void trail_adv::more_than_three_intermediate_sbox(size_type rounds, bitstr op_ma
       curr_sbox_info.op_masks[curr_sbox_info.curr_box] = it->first & ((1 << sboxes[curr_sbox_info.curr_box].output_size) - 1);
       curr_sbox_info.biases[curr_sbox_info.curr_box] = score;
       curr_sbox_info.curr_bias = eval_bias(curr_sbox_info.biases, curr_sbox_info.curr_box + 1);
+      curr_sbox_info.curr_weight += weight;
       // Check if we reached the last sbox
       if (curr_sbox_info.curr_box + 1 < sboxes.size()) {
         // Increment current sbox
@@ -424,7 +450,8 @@ void trail_adv::more_than_three_intermediate_sbox(size_type rounds, bitstr op_ma
         curr_round_info.op_masks[curr_round_info.curr_round] = op_mask;
         curr_round_info.key_masks[curr_round_info.curr_round] = key_mask_bits;
         curr_round_info.biases[curr_round_info.curr_round] = curr_sbox_info.curr_bias;
-        curr_round_info.curr_bias = PILING(curr_round_info.curr_bias, curr_sbox_info.curr_bias);
+        curr_round_info.curr_bias = 2 * curr_round_info.curr_bias * curr_sbox_info.curr_bias;
+        curr_round_info.curr_weight += curr_sbox_info.curr_weight;
         curr_round_info.curr_round = curr_round_info.curr_round + 1;
         // Check if we are at the penultimate round
         if (curr_round_info.curr_round < rounds - 1) {
@@ -473,9 +500,9 @@ void trail_adv::more_than_three_final_sbox(size_type rounds, bitstr op_mask) {
   auto lat_entry = sboxes[curr_sbox_info.curr_box].sieve_lat(op)[0];
   // Get score
   float score = lat_entry.second / float(1 << (sboxes[curr_sbox_info.curr_box].input_size + 1));
+  weight_type weight = bias_weight(score);
   // Check if better
-  if (PILING2(curr_round_info.curr_bias, score, curr_sbox_info.curr_bias) > 
-        FABS(fin_trails[rounds - 1][MEMO_SIZE - 1].curr_bias)) {
+  if (curr_round_info.curr_weight + weight + curr_sbox_info.curr_weight < memo_bound(rounds)) {
     // Store current sbox info
     auto temp_s = curr_sbox_info;
     // Update current sbox info
@@ -483,6 +510,7 @@ void trail_adv::more_than_three_final_sbox(size_type rounds, bitstr op_mask) {
     curr_sbox_info.op_masks[curr_sbox_info.curr_box] = lat_entry.first & ((1 << sboxes[curr_sbox_info.curr_box].output_size) - 1);
     curr_sbox_info.biases[curr_sbox_info.curr_box] = score;
     curr_sbox_info.curr_bias = eval_bias(curr_sbox_info.biases, curr_sbox_info.curr_box + 1);
+    curr_sbox_info.curr_weight += weight;
     // Check if we reached the last sbox
     if (curr_sbox_info.curr_box + 1 < sboxes.size()) {
       // Increment current sbox
@@ -507,7 +535,8 @@ void trail_adv::more_than_three_final_sbox(size_type rounds, bitstr op_mask) {
       curr_round_info.op_masks[curr_round_info.curr_round] = op_mask;
       curr_round_info.key_masks[curr_round_info.curr_round] = key_mask_bits;
       curr_round_info.biases[curr_round_info.curr_round] = curr_sbox_info.curr_bias;
-      curr_round_info.curr_bias = PILING(curr_round_info.curr_bias, curr_sbox_info.curr_bias);
+      curr_round_info.curr_bias = 2 * curr_round_info.curr_bias * curr_sbox_info.curr_bias;
+      curr_round_info.curr_weight += curr_sbox_info.curr_weight;
       std::cout << "BIAS UPDATE: " << curr_round_info.curr_bias << std::endl;
       // Add to final trails and biases
       place(fin_trails[rounds - 1], curr_round_info);
@@ -16,6 +16,7 @@
 #include "sbox.h"
 #include "bitstr.h"
 #include "perm.h"
+#include "weight.h"
 
 // Mains
 #include <iostream>
@@ -69,6 +70,7 @@ class trail_adv
     // Current Stuff
     size_type curr_round;
     float curr_bias;
+    weight_type curr_weight;        // of curr_bias, which the searches compare
 
     // Default Constructor
     round_info() {
@@ -81,6 +83,7 @@ class trail_adv
       // Initialize current round and bias
       curr_round = 0;
       curr_bias = 0.5f;
+      curr_weight = 0;
     }
   };
   round_info curr_round_info;
@@ -98,6 +101,7 @@ class trail_adv
     // Current Stuff
     size_type curr_box;
     float curr_bias;
+    weight_type curr_weight;        // of curr_bias, which the searches compare
 
     // Default Constructor
     sbox_info() {
@@ -109,6 +113,7 @@ class trail_adv
       // Initialize current box and bias
       curr_box = 0;
       curr_bias = 0.5f;
+      curr_weight = 0;
     }
   };
   sbox_info curr_sbox_info;
@@ -120,6 +125,7 @@ class trail_adv
   // Import key-schedule from cipher
   std::vector<std::vector<size_type>> round_sch;
   size_type key_size;
+  uint64_t fingerprint;
 
   // Constructor
   trail_adv(const feistel& cipher);
@@ -143,6 +149,10 @@ class trail_adv
   void more_than_three_final(size_type rounds);
   void more_than_three_final_sbox(size_type rounds, bitstr op_mask);
 
+  // Weight of the MEMO_SIZE-th (or last) trail kept for a number of rounds,
+  // the bar a candidate has to beat
+  weight_type memo_bound(size_type rounds) const;
+
   // Trail Masks
   std::vector<std::tuple<bitstr, bitstr, bitstr>> trail_masks(size_type rounds);
   
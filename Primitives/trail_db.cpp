@@ -0,0 +1,315 @@
+// Implementation of the trail store
+
+// Header Inclusion
+#include "trail_db.h"
+
+// Standard C++ Libraries
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+
+// System
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// File header and record header
+struct trail_db_header {
+  char magic[8];
+  uint64_t fingerprint;
+  uint64_t stage_0;
+  uint64_t stage_1;
+  uint64_t stage_3;
+  uint64_t top_k;
+  uint64_t count;
+};
+
+struct trail_record_header {
+  uint64_t rounds;
+  int64_t weight;
+  float bias;
+  uint32_t pad;
+};
+
+static const char TRAIL_DB_MAGIC[8] = {'L', 'S', 'T', 'R', 'A', 'I', 'L', '1'};
+
+// Constructors
+trail_db::trail_db(const feistel& cipher, size_type top_k) : map(nullptr), map_len(0)
+{
+  if (top_k == 0) {
+    throw std::invalid_argument("A trail store must keep at least one trail per round count.");
+  }
+  fingerprint = cipher.fingerprint();
+  stage_0 = cipher.rf_before.ip_size;
+  stage_1 = cipher.rf_before.op_size;
+  stage_3 = cipher.rf_after.op_size;
+  this->top_k = top_k;
+}
+
+trail_db::trail_db(const std::string& path) : map(nullptr), map_len(0)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::invalid_argument("Cannot open trail file " + path + ".");
+  }
+  struct stat st;
+  trail_db_header head;
+  bool ok = fstat(fd, &st) == 0 && size_type(st.st_size) >= sizeof(head) &&
+            pread(fd, &head, sizeof(head), 0) == ssize_t(sizeof(head)) &&
+            std::memcmp(head.magic, TRAIL_DB_MAGIC, sizeof(head.magic)) == 0 && head.top_k > 0;
+  if (!ok) {
+    close(fd);
+    throw std::invalid_argument("Not a trail file: " + path + ".");
+  }
+  fingerprint = head.fingerprint;
+  stage_0 = head.stage_0;
+  stage_1 = head.stage_1;
+  stage_3 = head.stage_3;
+  top_k = head.top_k;
+
+  map_len = st.st_size;
+  map = mmap(nullptr, map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    map = nullptr;
+    throw std::runtime_error("Cannot map trail file " + path + ".");
+  }
+
+  // Index the records
+  const uint8_t* base = static_cast<const uint8_t*>(map);
+  size_type offset = sizeof(head);
+  for (uint64_t i = 0; i < head.count; ++i) {
+    trail_record_header rec;
+    ok = offset + sizeof(rec) <= map_len;
+    if (ok) {
+      std::memcpy(&rec, base + offset, sizeof(rec));
+      ok = rec.rounds > 0 && rec.rounds <= map_len && offset + record_size(rec.rounds) <= map_len;
+    }
+    if (!ok) {
+      munmap(map, map_len);
+      map = nullptr;
+      throw std::invalid_argument("Truncated trail file: " + path + ".");
+    }
+    if (offsets.size() < rec.rounds) offsets.resize(rec.rounds);
+    offsets[rec.rounds - 1].push_back(offset);
+    offset += record_size(rec.rounds);
+  }
+}
+
+trail_db::~trail_db()
+{
+  if (map) munmap(map, map_len);
+}
+
+// Sizes
+size_type trail_db::max_rounds() const
+{
+  size_type slots = mapped() ? offsets.size() : trails.size();
+  while (slots > 0 && count(slots) == 0) --slots;
+  return slots;
+}
+
+size_type trail_db::count(size_type rounds) const
+{
+  if (rounds == 0) return 0;
+  if (mapped()) return (rounds <= offsets.size()) ? offsets[rounds - 1].size() : 0;
+  return (rounds <= trails.size()) ? trails[rounds - 1].size() : 0;
+}
+
+bool trail_db::mapped() const
+{
+  return map != nullptr;
+}
+
+// Lookups
+trail::round_info trail_db::get(size_type rounds, size_type index) const
+{
+  if (index >= count(rounds)) {
+    throw std::out_of_range("No such trail in the store.");
+  }
+  if (mapped()) return decode(offsets[rounds - 1][index]);
+  return trails[rounds - 1][index];
+}
+
+weight_type trail_db::weight(size_type rounds, size_type index) const
+{
+  if (index >= count(rounds)) {
+    throw std::out_of_range("No such trail in the store.");
+  }
+  if (!mapped()) return trails[rounds - 1][index].curr_weight;
+  trail_record_header rec;
+  std::memcpy(&rec, static_cast<const uint8_t*>(map) + offsets[rounds - 1][index], sizeof(rec));
+  return rec.weight;
+}
+
+// Adding trails
+void trail_db::add(const trail::round_info& found)
+{
+  size_type rounds = found.biases.size();
+  if (rounds == 0 || found.ip_masks.size() != rounds || found.op_masks.size() != rounds || found.key_masks.size() != rounds) {
+    throw std::invalid_argument("Trail must have masks and a bias for every round.");
+  }
+  for (size_type r = 0; r < rounds; ++r) {
+    if (found.ip_masks[r].bit_size != stage_0 || found.op_masks[r].bit_size != stage_3 || found.key_masks[r].bit_size != stage_1) {
+      throw std::invalid_argument("Trail mask sizes do not match the store.");
+    }
+  }
+  materialize();
+  if (trails.size() < rounds) trails.resize(rounds);
+  std::vector<trail::round_info>& slot = trails[rounds - 1];
+
+  // Skip trails already stored
+  for (const auto& known : slot) {
+    if (known.curr_weight != found.curr_weight) continue;
+    bool same = true;
+    for (size_type r = 0; r < rounds && same; ++r) {
+      same = known.ip_masks[r] == found.ip_masks[r] && known.op_masks[r] == found.op_masks[r] &&
+             known.key_masks[r] == found.key_masks[r];
+    }
+    if (same) return;
+  }
+
+  // Insert by weight, after equal ones, and keep the top_k
+  auto pos = std::upper_bound(slot.begin(), slot.end(), found.curr_weight,
+                              [](weight_type w, const trail::round_info& t) { return w < t.curr_weight; });
+  if (size_type(pos - slot.begin()) >= top_k) return;
+  slot.insert(pos, found);
+  if (slot.size() > top_k) slot.pop_back();
+}
+
+void trail_db::add(const trail& search)
+{
+  if (search.fingerprint != fingerprint) {
+    throw std::invalid_argument("Trails belong to another cipher.");
+  }
+  // Skip any round without masks
+  for (const auto& found : search.fin_trails) {
+    if (!found.biases.empty()) add(found);
+  }
+}
+
+void trail_db::add(const trail_adv& search)
+{
+  if (search.fingerprint != fingerprint) {
+    throw std::invalid_argument("Trails belong to another cipher.");
+  }
+  for (size_type i = 0; i < search.fin_trails.size(); ++i) {
+    for (const auto& entry : search.fin_trails[i]) {
+      // Skip any entry without masks
+      if (entry.biases.size() != i + 1) continue;
+      trail::round_info found = trail::round_info();
+      found.ip_masks = entry.ip_masks;
+      found.op_masks = entry.op_masks;
+      found.key_masks = entry.key_masks;
+      found.biases = entry.biases;
+      found.curr_round = entry.curr_round;
+      found.curr_bias = entry.curr_bias;
+      found.curr_weight = entry.curr_weight;
+      add(found);
+    }
+  }
+}
+
+// Check
+void trail_db::check(const feistel& cipher) const
+{
+  if (cipher.fingerprint() != fingerprint) {
+    throw std::invalid_argument("Trail store belongs to another cipher.");
+  }
+}
+
+// Save
+void trail_db::save(const std::string& path) const
+{
+  trail_db_header head;
+  std::memcpy(head.magic, TRAIL_DB_MAGIC, sizeof(head.magic));
+  head.fingerprint = fingerprint;
+  head.stage_0 = stage_0;
+  head.stage_1 = stage_1;
+  head.stage_3 = stage_3;
+  head.top_k = top_k;
+  head.count = 0;
+  for (size_type r = 1; r <= max_rounds(); ++r) head.count += count(r);
+
+  // Write beside the target and rename, so maps of the old file (this
+  // store's own included) stay valid
+  std::string tmp = path + ".tmp." + std::to_string(getpid());
+  std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+  for (size_type r = 1; r <= max_rounds(); ++r) {
+    for (size_type i = 0; i < count(r); ++i) {
+      trail::round_info found = get(r, i);
+      trail_record_header rec = {r, found.curr_weight, found.curr_bias, 0};
+      out.write(reinterpret_cast<const char*>(&rec), sizeof(rec));
+      for (size_type j = 0; j < r; ++j) {
+        out.write(reinterpret_cast<const char*>(found.ip_masks[j].blocks), words(stage_0) * sizeof(block_type));
+        out.write(reinterpret_cast<const char*>(found.op_masks[j].blocks), words(stage_3) * sizeof(block_type));
+        out.write(reinterpret_cast<const char*>(found.key_masks[j].blocks), words(stage_1) * sizeof(block_type));
+      }
+      std::vector<float> biases(found.biases);
+      biases.resize((r + 1) / 2 * 2, 0.0f);
+      out.write(reinterpret_cast<const char*>(biases.data()), biases.size() * sizeof(float));
+    }
+  }
+  out.close();
+  if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("Cannot write trail file " + path + ".");
+  }
+}
+
+// Helpers
+size_type trail_db::words(size_type bits) const
+{
+  return (bits + bitstr::BITS_PER_BLOCK - 1) / bitstr::BITS_PER_BLOCK;
+}
+
+size_type trail_db::record_size(size_type rounds) const
+{
+  size_type masks = rounds * (words(stage_0) + words(stage_3) + words(stage_1)) * sizeof(block_type);
+  return sizeof(trail_record_header) + masks + (rounds + 1) / 2 * 2 * sizeof(float);
+}
+
+trail::round_info trail_db::decode(size_type offset) const
+{
+  const uint8_t* at = static_cast<const uint8_t*>(map) + offset;
+  trail_record_header rec;
+  std::memcpy(&rec, at, sizeof(rec));
+  at += sizeof(rec);
+
+  trail::round_info found = trail::round_info();
+  found.curr_round = rec.rounds - 1;
+  found.curr_bias = rec.bias;
+  found.curr_weight = rec.weight;
+  for (size_type r = 0; r < rec.rounds; ++r) {
+    bitstr ip(stage_0), op(stage_3), key(stage_1);
+    std::memcpy(ip.blocks, at, words(stage_0) * sizeof(block_type));
+    at += words(stage_0) * sizeof(block_type);
+    std::memcpy(op.blocks, at, words(stage_3) * sizeof(block_type));
+    at += words(stage_3) * sizeof(block_type);
+    std::memcpy(key.blocks, at, words(stage_1) * sizeof(block_type));
+    at += words(stage_1) * sizeof(block_type);
+    found.ip_masks.push_back(ip);
+    found.op_masks.push_back(op);
+    found.key_masks.push_back(key);
+  }
+  found.biases.resize(rec.rounds);
+  std::memcpy(found.biases.data(), at, rec.rounds * sizeof(float));
+  return found;
+}
+
+// Copy a mapped store into memory (before it changes)
+void trail_db::materialize()
+{
+  if (!mapped()) return;
+  trails.assign(offsets.size(), {});
+  for (size_type r = 1; r <= offsets.size(); ++r) {
+    for (size_type offset : offsets[r - 1]) trails[r - 1].push_back(decode(offset));
+  }
+  offsets.clear();
+  munmap(map, map_len);
+  map = nullptr;
+  map_len = 0;
+}
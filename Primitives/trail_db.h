@@ -0,0 +1,93 @@
+// Persistent store of the best linear trails of a cipher, keyed by its
+// fingerprint, so that searches resume from the known bounds and attacks
+// take their approximations without searching at all
+
+/*
+ * CONTENTS:
+ * For every number of rounds the store keeps up to top_k trails, sorted
+ * by weight (then by insertion order on ties); a trail equal to a stored
+ * one is not added again. The best trail of each round count is the bound
+ * a search for more rounds starts from (trail::load). trail gives one
+ * trail per round count; trail_adv gives up to MEMO_SIZE, which is what
+ * fills a top_k > 1 store.
+ */
+
+/*
+ * FILES:
+ * save writes a header (fingerprint, stage sizes, top_k, trail count)
+ * followed by one record per trail: rounds, weight and bias, then the
+ * raw bitstr words of the input, output and key masks of every round and
+ * the round biases. The path constructor maps such a file read-only and
+ * only indexes the records; trails are decoded when asked for, and the
+ * store is copied into memory on the first add. save writes a temporary
+ * file and renames it over the path, so a mapped store (even one saved
+ * back to its own file) is never truncated under its readers.
+ */
+
+#ifndef TRAIL_DB_H
+#define TRAIL_DB_H
+
+// Custom Libraries
+#include "bitstr.h"
+#include "feistel.h"
+#include "trail.h"
+#include "trail_adv.h"
+#include "weight.h"
+
+// Standard C++ Libraries
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+
+// Class
+class trail_db {
+  public:
+    uint64_t fingerprint;     // of the cipher description
+    size_type stage_0;        // half block (input masks)
+    size_type stage_1;        // S-Box layer input (key masks)
+    size_type stage_3;        // half block (output masks)
+    size_type top_k;          // trails kept per number of rounds
+
+    // Constructors (empty store for a cipher, or map a saved store)
+    trail_db(const feistel& cipher, size_type top_k = 1);
+    explicit trail_db(const std::string& path);
+    ~trail_db();
+
+    trail_db(const trail_db&) = delete;
+    trail_db& operator=(const trail_db&) = delete;
+
+    // Largest number of rounds with a trail, and the trails stored for a round count
+    size_type max_rounds() const;
+    size_type count(size_type rounds) const;
+    bool mapped() const;
+
+    // Stored trails (index 0 is the best)
+    trail::round_info get(size_type rounds, size_type index = 0) const;
+    weight_type weight(size_type rounds, size_type index = 0) const;
+
+    // Add trails (kept if among the top_k of their round count)
+    void add(const trail::round_info& found);
+    void add(const trail& search);
+    void add(const trail_adv& search);
+
+    // Throw unless the store belongs to the cipher
+    void check(const feistel& cipher) const;
+
+    // Write to a file for the path constructor
+    void save(const std::string& path) const;
+
+  private:
+    std::vector<std::vector<trail::round_info>> trails;     // [rounds - 1], in memory
+    std::vector<std::vector<size_type>> offsets;            // [rounds - 1], records in the map
+    void* map;
+    size_type map_len;
+
+    // Helpers
+    size_type words(size_type bits) const;
+    size_type record_size(size_type rounds) const;
+    trail::round_info decode(size_type offset) const;
+    void materialize();
+};
+
+#endif
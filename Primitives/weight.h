@@ -0,0 +1,44 @@
+// Fixed-point log2 weights of linear correlations, so that piling up
+// becomes an integer sum and bounds compare exactly
+
+/*
+ * WEIGHTS:
+ * A correlation c = 2 * bias has weight w = -log2|c|, kept in fixed point
+ * with WEIGHT_FRAC fractional bits and rounded to nearest. The weight of a
+ * trail is the sum of the weights of its approximations, whatever the
+ * order of the sum, so searches over weights are exact and reproducible
+ * (ties included). Signs are not part of the weight; they come from the
+ * LAT entries themselves when a trail is written out.
+ */
+
+#ifndef WEIGHT_H
+#define WEIGHT_H
+
+// Standard C++ libraries
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+// Aliases for types
+using weight_type = int64_t;
+
+constexpr int WEIGHT_FRAC = 24;
+constexpr weight_type WEIGHT_ONE = weight_type(1) << WEIGHT_FRAC;     // weight of a 1/2 correlation
+constexpr weight_type WEIGHT_INF = std::numeric_limits<weight_type>::max() / 4;
+
+// Weight of a bias (0 for 1/2, WEIGHT_INF for 0)
+inline weight_type bias_weight(double bias)
+{
+  double corr = std::abs(2 * bias);
+  if (corr == 0) return WEIGHT_INF;
+  return weight_type(std::llround(-std::log2(corr) * WEIGHT_ONE));
+}
+
+// Largest |bias| of a weight
+inline double weight_bias(weight_type weight)
+{
+  if (weight >= WEIGHT_INF) return 0;
+  return 0.5 * std::exp2(-double(weight) / WEIGHT_ONE);
+}
+
+#endif
@@ -6,6 +6,10 @@
 #include <stdexcept>
 #include <random>
 #include <string>
+#include <array>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
 
 // Custom-libs
 #include "Primitives/bitstr.h"
@@ -16,6 +20,124 @@
 #include "Primitives/trail_adv.h"
 #include "Primitives/attack.h"
 #include "Primitives/bool_fn.h"
+#include "Primitives/prng.h"
+#include "Primitives/feistel_static.h"
+#include "Primitives/feistel_bs.h"
+#include "Primitives/codebook.h"
+#include "Primitives/feistel_jit.h"
+#include "Primitives/corr_exact.h"
+#include "Primitives/rf_corr.h"
+#include "Primitives/nl_inv.h"
+#include "Primitives/trail_db.h"
+
+// DES as a compile-time specification (for feistel_static)
+struct des_spec {
+  static constexpr size_type block_size = 64;
+  static constexpr size_type key_size = 64;
+  static constexpr size_type rounds = 16;
+  static constexpr size_type sbox_count = 8;
+  static constexpr size_type sbox_in = 6;
+  static constexpr size_type sbox_out = 4;
+
+  static constexpr std::array<size_type, 64> ip = {
+    57, 49, 41, 33, 25, 17,  9,  1,
+    59, 51, 43, 35, 27, 19, 11,  3,
+    61, 53, 45, 37, 29, 21, 13,  5,
+    63, 55, 47, 39, 31, 23, 15,  7,
+    56, 48, 40, 32, 24, 16,  8,  0,
+    58, 50, 42, 34, 26, 18, 10,  2,
+    60, 52, 44, 36, 28, 20, 12,  4,
+    62, 54, 46, 38, 30, 22, 14,  6
+  };
+  static constexpr std::array<size_type, 64> fp = {
+    39,  7, 47, 15, 55, 23, 63, 31,
+    38,  6, 46, 14, 54, 22, 62, 30,
+    37,  5, 45, 13, 53, 21, 61, 29,
+    36,  4, 44, 12, 52, 20, 60, 28,
+    35,  3, 43, 11, 51, 19, 59, 27,
+    34,  2, 42, 10, 50, 18, 58, 26,
+    33,  1, 41,  9, 49, 17, 57, 25,
+    32,  0, 40,  8, 48, 16, 56, 24
+  };
+  static constexpr std::array<size_type, 48> rf_before = {
+    31,  0,  1,  2,  3,  4,  3,  4,  5,  6,  7,  8,
+     7,  8,  9, 10, 11, 12, 11, 12, 13, 14, 15, 16,
+    15, 16, 17, 18, 19, 20, 19, 20, 21, 22, 23, 24,
+    23, 24, 25, 26, 27, 28, 27, 28, 29, 30, 31,  0
+  };
+  static constexpr std::array<size_type, 32> rf_after = {
+    15,  6, 19, 20, 28, 11, 27, 16,  0, 14, 22, 25,  4, 17, 30,  9,
+     1,  7, 23, 13, 31, 26,  2,  8, 18, 12, 29,  5, 21, 10,  3, 24
+  };
+  static constexpr std::array<std::array<size_type, 64>, 8> sboxes = {{
+    {
+      14,  0,  4, 15, 13,  7,  1,  4,  2, 14, 15,  2, 11, 13,  8,  1,
+       3, 10, 10,  6,  6, 12, 12, 11,  5,  9,  9,  5,  0,  3,  7,  8,
+       4, 15,  1, 12, 14,  8,  8,  2, 13,  4,  6,  9,  2,  1, 11,  7,
+      15,  5, 12, 11,  9,  3,  7, 10,  3, 14, 10,  0,  5,  6,  0, 13
+    },
+    {
+      15,  3,  0, 13, 14,  8, 13,  6, 10, 15,  7,  1,  3,  4,  9, 11,
+       0, 14,  6, 10,  9,  2,  1,  8,  7, 13,  2, 15, 12, 12,  5,  4,
+       8,  1, 14,  6,  4,  7, 11, 10,  1,  9, 10,  0,  5,  3,  0, 14,
+       6, 11,  2,  8, 13,  5, 15,  2,  9, 12, 12,  3,  7,  4,  5, 11
+    },
+    {
+      10, 13,  0,  7,  9,  0, 14,  9,  6,  3,  3,  4, 15,  6,  5, 10,
+       1,  2, 13,  8, 12,  5,  7, 14, 11, 12,  4, 11,  2, 15,  8,  1,
+      13,  1,  6, 10,  4, 13,  9,  0,  8,  6, 15,  9,  3,  8,  0,  7,
+      11,  4,  1, 15,  2, 14, 12,  3,  5, 11, 10,  5, 14,  2,  7, 12
+    },
+    {
+       7, 13, 13,  8, 14, 11,  3,  5,  0,  6,  6, 15,  9,  0, 10,  3,
+       1,  4,  2,  7,  8,  2,  5, 12, 11,  1, 12, 10,  4, 14, 15,  9,
+      10,  3,  6, 15,  9,  0,  0,  6, 12, 10, 11,  1,  7, 13, 13,  8,
+      15,  9,  1,  4,  3,  5, 14, 11,  5, 12,  2,  7,  8,  2,  4, 14
+    },
+    {
+       2, 14, 12, 11,  4,  2,  1, 12,  7,  4, 10,  7, 11, 13,  6,  1,
+       8,  5,  5,  0,  3, 15, 15, 10, 13,  3,  0,  9, 14,  8,  9,  6,
+       4, 11,  2,  8,  1, 12, 11,  7, 10,  1, 13, 14,  7,  2,  8, 13,
+      15,  6,  9, 15, 12,  0,  5,  9,  6, 10,  3,  4,  0,  5, 14,  3
+    },
+    {
+      12, 10,  1, 15, 10,  4, 15,  2,  9,  7,  2, 12,  6,  9,  8,  5,
+       0,  6, 13,  1,  3, 13,  4, 14, 14,  0, 11,  3,  5, 11,  7,  8,
+       1, 13,  6,  0,  4, 11, 11,  7, 13, 12,  0,  5, 10, 14,  3, 10,
+       9,  3, 14,  9,  5,  6,  2,  8,  7,  2,  8,  1, 12,  4, 15, 15
+    },
+    {
+       4, 13, 11,  0,  2, 11, 14,  7, 15,  4,  0,  9,  8,  1, 13, 10,
+       3, 14, 12,  3,  9,  5,  7, 12,  5,  2, 10, 15,  6,  8,  1,  6,
+       1,  6,  4, 11, 11, 13, 13,  8, 12,  1,  3,  4,  7, 10, 14,  7,
+      10,  9, 15,  5,  6,  0,  8, 15,  0, 14,  5,  2,  9,  3,  2, 12
+    },
+    {
+      13,  1,  2, 15,  8, 13,  4,  8,  6, 10, 15,  3, 11,  7,  1,  4,
+      10, 12,  9,  5,  3,  6, 14, 11,  5,  0,  0, 14, 12,  9,  7,  2,
+       7,  2, 11,  1,  4, 14,  1,  7,  9,  4, 12, 10, 14,  8,  2, 13,
+       0, 15,  6, 12, 10,  9, 13,  0, 15,  3,  3,  5,  5,  6,  8, 11
+    }
+  }};
+  static constexpr std::array<std::array<size_type, 48>, 16> round_sch = {{
+    {13, 16, 10, 23, 0, 4, 2, 27, 14, 5, 20, 9, 22, 18, 11, 3, 25, 7, 15, 6, 26, 19, 12, 1, 40, 51, 30, 36, 46, 54, 29, 39, 50, 44, 32, 47, 43, 48, 38, 55, 33, 52, 45, 35, 28, 31, 37, 34},
+    {12, 15, 9, 22, 63, 3, 1, 26, 13, 4, 19, 8, 21, 17, 10, 2, 24, 6, 14, 5, 25, 18, 11, 0, 39, 50, 29, 35, 45, 53, 28, 38, 49, 43, 31, 46, 42, 47, 37, 54, 32, 51, 44, 34, 27, 30, 36, 33},
+    {10, 13, 7, 20, 61, 1, 63, 24, 11, 2, 17, 6, 19, 15, 8, 0, 22, 4, 12, 3, 23, 16, 9, 62, 37, 48, 27, 33, 43, 51, 26, 36, 47, 41, 29, 44, 40, 45, 35, 52, 30, 49, 42, 32, 25, 28, 34, 31},
+    {8, 11, 5, 18, 59, 63, 61, 22, 9, 0, 15, 4, 17, 13, 6, 62, 20, 2, 10, 1, 21, 14, 7, 60, 35, 46, 25, 31, 41, 49, 24, 34, 45, 39, 27, 42, 38, 43, 33, 50, 28, 47, 40, 30, 23, 26, 32, 29},
+    {6, 9, 3, 16, 57, 61, 59, 20, 7, 62, 13, 2, 15, 11, 4, 60, 18, 0, 8, 63, 19, 12, 5, 58, 33, 44, 23, 29, 39, 47, 22, 32, 43, 37, 25, 40, 36, 41, 31, 48, 26, 45, 38, 28, 21, 24, 30, 27},
+    {4, 7, 1, 14, 55, 59, 57, 18, 5, 60, 11, 0, 13, 9, 2, 58, 16, 62, 6, 61, 17, 10, 3, 56, 31, 42, 21, 27, 37, 45, 20, 30, 41, 35, 23, 38, 34, 39, 29, 46, 24, 43, 36, 26, 19, 22, 28, 25},
+    {2, 5, 63, 12, 53, 57, 55, 16, 3, 58, 9, 62, 11, 7, 0, 56, 14, 60, 4, 59, 15, 8, 1, 54, 29, 40, 19, 25, 35, 43, 18, 28, 39, 33, 21, 36, 32, 37, 27, 44, 22, 41, 34, 24, 17, 20, 26, 23},
+    {1, 4, 62, 11, 52, 56, 54, 15, 2, 57, 8, 61, 10, 6, 63, 55, 13, 59, 3, 58, 14, 7, 0, 53, 28, 39, 18, 24, 34, 42, 17, 27, 38, 32, 20, 35, 31, 36, 26, 43, 21, 40, 33, 23, 16, 19, 25, 22},
+    {0, 3, 61, 10, 51, 55, 53, 14, 1, 56, 7, 60, 9, 5, 62, 54, 12, 58, 2, 57, 13, 6, 63, 52, 27, 38, 17, 23, 33, 41, 16, 26, 37, 31, 19, 34, 30, 35, 25, 42, 20, 39, 32, 22, 15, 18, 24, 21},
+    {62, 2, 60, 9, 50, 54, 52, 13, 0, 55, 6, 59, 8, 4, 61, 53, 11, 57, 1, 56, 12, 5, 62, 51, 26, 37, 16, 22, 32, 40, 15, 25, 36, 30, 18, 33, 29, 34, 24, 41, 19, 38, 31, 21, 14, 17, 23, 20},
+    {60, 0, 58, 7, 48, 52, 50, 11, 62, 53, 4, 57, 6, 2, 59, 51, 9, 55, 63, 54, 10, 3, 60, 49, 24, 35, 14, 20, 30, 38, 13, 23, 34, 28, 16, 31, 27, 32, 22, 39, 17, 36, 29, 19, 12, 15, 21, 18},
+    {58, 62, 56, 5, 46, 50, 48, 9, 60, 51, 2, 55, 4, 0, 57, 49, 7, 53, 61, 52, 8, 1, 58, 47, 22, 33, 12, 18, 28, 36, 11, 21, 32, 26, 14, 29, 25, 30, 20, 37, 15, 34, 27, 17, 10, 13, 19, 16},
+    {56, 60, 54, 3, 44, 48, 46, 7, 58, 49, 0, 53, 2, 62, 55, 47, 5, 51, 59, 50, 6, 63, 56, 45, 20, 31, 10, 16, 26, 34, 9, 19, 30, 24, 12, 27, 23, 28, 18, 35, 13, 32, 25, 15, 8, 11, 17, 14},
+    {55, 59, 53, 2, 43, 47, 45, 6, 57, 48, 63, 52, 1, 61, 54, 46, 4, 50, 58, 49, 5, 62, 55, 44, 19, 30, 9, 15, 25, 33, 8, 18, 29, 23, 11, 26, 22, 27, 17, 34, 12, 31, 24, 14, 7, 10, 16, 13},
+    {54, 58, 52, 1, 42, 46, 44, 5, 56, 47, 62, 51, 0, 60, 53, 45, 3, 49, 57, 48, 4, 61, 54, 43, 18, 29, 8, 14, 24, 32, 7, 17, 28, 22, 10, 25, 21, 26, 16, 33, 11, 30, 23, 13, 6, 9, 15, 12},
+    {53, 57, 51, 0, 41, 45, 43, 4, 55, 46, 61, 50, 63, 59, 52, 44, 2, 48, 56, 47, 3, 60, 53, 42, 17, 28, 7, 13, 23, 31, 6, 16, 27, 21, 9, 24, 20, 25, 15, 32, 10, 29, 22, 12, 5, 8, 14, 11}
+  }};
+};
 
 // Main
 int main() {
@@ -153,11 +275,12 @@ int main() {
   // Create Feistel instance
   feistel des(block_size, max_rounds, key_size, ip, fp, sboxes, rf_before, rf_after, round_sch);
 
+  // Seed for all random data (fixed, so runs can be repeated)
+  uint64_t seed = 2024;
+  prng gen(seed);
+
   // Create a random key and assign
-  bitstr key(64);
-  for (size_type i = 0; i < 64; ++i) {
-    key[i] = rand() % 2; // Randomly set bits
-  }
+  bitstr key = rand_bitstr(64, gen);
   des.assign_key(key);
 
   // Check trail class init
@@ -181,7 +304,7 @@ int main() {
   std::cout << c.get_bits() << std::endl;
 
   // Launch Attack
-  attack a1(a, b, c, t.fin_trails[2].curr_bias, 3, des);
+  attack a1(a, b, c, t.fin_trails[2].curr_bias, 3, des, seed);
 
   // Matsui-2
   auto [x,y] = a1.matsui2_dist(350000);
@@ -195,10 +318,10 @@ int main() {
   std::vector<bitstr> inv = temp.balanced_invariants;
 
   // Print cycles
-  for (uint i = 0; i < temp.cycles.size(); ++i) {
+  for (uint i = 0; i < temp.get_cycles().size(); ++i) {
     std::cout << "Cycle " << i << ": ";
-    for (uint j = 0; j < temp.cycles[i].size(); ++j) {
-      std::cout << temp.cycles[i][j] << " ";
+    for (uint j = 0; j < temp.get_cycles()[i].size(); ++j) {
+      std::cout << temp.get_cycles()[i][j] << " ";
     }
     std::cout << std::endl;
   }
@@ -244,17 +367,17 @@ int main() {
   // Print cycles
   test.get_balanced_invariants();
   std::vector<bitstr> inv = test.balanced_invariants;
-  for (uint i = 0; i < test.cycles.size(); ++i) {
+  for (uint i = 0; i < test.get_cycles().size(); ++i) {
     std::cout << "Cycle " << i << ": ";
-    for (uint j = 0; j < test.cycles[i].size(); ++j) {
-      std::cout << test.cycles[i][j] << " ";
+    for (uint j = 0; j < test.get_cycles()[i].size(); ++j) {
+      std::cout << test.get_cycles()[i][j] << " ";
     }
     std::cout << std::endl;
   }
 
   // Print cycle sizes
   std::cout << "Cycle sizes: ";
-  for (const auto& cycle : test.cycles) {
+  for (const auto& cycle : test.get_cycles()) {
     std::cout << cycle.size() << " ";
   }
 
@@ -272,6 +395,306 @@ int main() {
     func.print_polynomial();
   } */
 
+  // Compile-time specialised DES against the generic path (a plain feistel
+  // copy), through contexts as attack and codebook use them
+  prng check_gen(2024);
+  auto des_static = std::make_shared<const feistel_static<des_spec>>();
+  auto des_generic = std::make_shared<const feistel>(feistel(*des_static));
+  bitstr check_key = rand_bitstr(64, check_gen);
+  feistel_ctx fast(des_static, check_key), slow(des_generic, check_key);
+  bool static_ok = true;
+  for (int i = 0; i < 256; ++i) {
+    bitstr pt = rand_bitstr(64, check_gen);
+    static_ok = static_ok && (fast.encrypt(pt, 16) == slow.encrypt(pt, 16)) && (fast.decrypt(fast.encrypt(pt, 16), 16) == pt);
+  }
+  std::cout << "Static DES matches generic DES: " << static_ok << std::endl;
+
+  // Bitsliced engines of every lane width against the table engine
+  std::vector<uint64_t> bs_in(512), bs_out(512);
+  check_gen.fill(bs_in.data(), bs_in.size());
+  bool bs_ok = true;
+  auto check_bs = [&](const auto& engine, size_type lanes) {
+    for (size_type beg = 0; beg < bs_in.size(); beg += lanes) engine.encrypt(bs_in.data() + beg, bs_out.data() + beg, 16);
+    for (size_type i = 0; i < bs_in.size(); ++i) {
+      bs_ok = bs_ok && slow.encrypt(bitstr(block_type(bs_in[i]), 64), 16) == bitstr(block_type(bs_out[i]), 64);
+    }
+  };
+  check_bs(feistel_bs64(*des_generic, *slow.sched), feistel_bs64::LANES);
+  check_bs(feistel_bs256(*des_generic, *slow.sched), feistel_bs256::LANES);
+  check_bs(feistel_bs512(*des_generic, *slow.sched), feistel_bs512::LANES);
+  std::cout << "Bitsliced DES (64/256/512 lanes) matches table DES: " << bs_ok << std::endl;
+
+  // Mask dot product is the GF(2) inner product: two common bits cancel,
+  // where the old "any common bit" result gave 1
+  bitstr dot_u(block_type(0x3), 8), dot_v(block_type(0x7), 8);
+  bool dot_ok = !(dot_u * dot_v);
+  for (int i = 0; i < 256; ++i) {
+    bitstr u = rand_bitstr(100, check_gen), v = rand_bitstr(100, check_gen);
+    bool parity = false;
+    for (size_type j = 0; j < 100; ++j) parity ^= u[j] && v[j];
+    dot_ok = dot_ok && (u * v) == parity;
+  }
+  std::cout << "Mask dot product is parity: " << dot_ok << std::endl;
+
+  // Standard DES key schedule procedurally (PC-1, shifts, PC-2): round keys
+  // of the FIPS 46 worked example, its index tables against expanding, and
+  // a cipher on the tables against one on the schedule
+  std::vector<size_type> pc1_table = {
+    56, 48, 40, 32, 24, 16,  8,  0, 57, 49, 41, 33, 25, 17,
+     9,  1, 58, 50, 42, 34, 26, 18, 10,  2, 59, 51, 43, 35,
+    62, 54, 46, 38, 30, 22, 14,  6, 61, 53, 45, 37, 29, 21,
+    13,  5, 60, 52, 44, 36, 28, 20, 12,  4, 27, 19, 11,  3
+  };
+  std::vector<size_type> pc2_table = {
+    13, 16, 10, 23,  0,  4,  2, 27, 14,  5, 20,  9,
+    22, 18, 11,  3, 25,  7, 15,  6, 26, 19, 12,  1,
+    40, 51, 30, 36, 46, 54, 29, 39, 50, 44, 32, 47,
+    43, 48, 38, 55, 33, 52, 45, 41, 49, 35, 28, 31
+  };
+  rotating_schedule des_sched(perm(64, 56, pc1_table), 2, {1, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1}, perm(56, 48, pc2_table));
+  bitstr fips_key(block_type(0x133457799BBCDFF1ULL), 64);
+  auto fips_rounds = des_sched.expand(fips_key);
+  auto fips_tables = des_sched.tables();
+  bool sched_ok = fips_rounds[0] == bitstr(block_type(0x1B02EFFC7072ULL), 48) && fips_rounds[15] == bitstr(block_type(0xCB3D8B0E17F5ULL), 48);
+  for (size_type r = 0; r < 16; ++r) sched_ok = sched_ok && fips_key.substitute(fips_tables[r], 48) == fips_rounds[r];
+  feistel des_proc(64, 16, 64, des_generic->ip, des_generic->fp, des_generic->sboxes, des_generic->rf_before, des_generic->rf_after, des_sched);
+  feistel des_tab(64, 16, 64, des_generic->ip, des_generic->fp, des_generic->sboxes, des_generic->rf_before, des_generic->rf_after, fips_tables);
+  des_proc.assign_key(fips_key);
+  des_tab.assign_key(fips_key);
+  bitstr fips_pt(block_type(0x0123456789ABCDEFULL), 64);
+  sched_ok = sched_ok && des_tab.encrypt(fips_pt, 16) == des_proc.encrypt(fips_pt, 16);
+  std::cout << "Rotating DES schedule matches FIPS 46 and its tables: " << sched_ok << std::endl;
+
+  // Toy 16-bit Feistel (two PRESENT S-Boxes per round), small enough for
+  // full codebooks and exhaustive counting
+  size_type toy_box[16] = {12, 5, 6, 11, 9, 0, 10, 13, 3, 14, 15, 8, 4, 7, 1, 2};
+  std::vector<sbox> toy_sboxes = {sbox(4, 4, toy_box), sbox(4, 4, toy_box)};
+  std::vector<size_type> toy_id = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+  std::vector<size_type> toy_half = {0, 1, 2, 3, 4, 5, 6, 7};
+  std::vector<size_type> toy_rot = {3, 4, 5, 6, 7, 0, 1, 2};
+  std::vector<std::vector<size_type>> toy_sch(6);
+  for (size_type r = 0; r < 6; ++r) {
+    for (size_type i = 0; i < 8; ++i) toy_sch[r].push_back((i + 5 * r) % 32);
+  }
+  auto toy = std::make_shared<const feistel>(16, 6, 32, perm(16, 16, toy_id), perm(16, 16, toy_id), toy_sboxes,
+                                             perm(8, 8, toy_half), perm(8, 8, toy_rot), toy_sch);
+  feistel_ctx toy_ctx(toy, rand_bitstr(32, check_gen));
+
+  // Codebook against the cipher, out-of-range plaintexts, and a save/map round trip
+  auto toy_book = std::make_shared<const codebook>(toy_ctx, 4);
+  bool book_ok = toy_book->size() == 65536;
+  for (uint64_t p = 0; p < toy_book->size(); ++p) {
+    book_ok = book_ok && toy_book->lookup(p) == toy_ctx.encrypt(bitstr(block_type(p), 16), 4).value(0, 16);
+    book_ok = book_ok && toy_book->lookup(p | (uint64_t(1) << 40)) == toy_book->lookup(p);
+  }
+  std::string book_path = "codebook_check.tmp";
+  toy_book->save(book_path);
+  {
+    codebook loaded(book_path);
+    book_ok = book_ok && loaded.mapped() && loaded.block_size == 16 && loaded.rounds == 4 &&
+              loaded.fingerprint == toy_book->fingerprint && loaded.key_hash == toy_book->key_hash;
+    for (uint64_t p = 0; p < loaded.size(); ++p) book_ok = book_ok && loaded.lookup(p) == toy_book->lookup(p);
+  }
+  std::remove(book_path.c_str());
+  std::cout << "Codebook matches the cipher and survives save/load: " << book_ok << std::endl;
+
+  // Generated DES against the table engine, built in a cache directory
+  // whose name has a space and a quote (passed to the compiler verbatim)
+  std::string jit_dir = std::filesystem::absolute("jit check 'dir").string();
+  bool jit_ok;
+  {
+    feistel_jit des_jit(des_generic, 16, jit_dir);
+    std::vector<uint64_t> jit_out(bs_in.size()), jit_back(bs_in.size());
+    des_jit.encrypt_batch(bs_in.data(), jit_out.data(), bs_in.size(), *slow.sched);
+    des_jit.decrypt_batch(jit_out.data(), jit_back.data(), bs_in.size(), *slow.sched);
+    jit_ok = des_jit.compiled() && jit_back == bs_in;
+    for (size_type i = 0; i < bs_in.size(); ++i) {
+      jit_ok = jit_ok && slow.encrypt(bitstr(block_type(bs_in[i]), 64), 16) == bitstr(block_type(jit_out[i]), 64);
+    }
+  }
+  std::filesystem::remove_all(jit_dir);
+  std::cout << "JIT DES matches table DES: " << jit_ok << std::endl;
+
+  // Batch encryption against one block at a time (a count that leaves a
+  // partial lane group), and batch decryption back
+  bool batch_ok = true;
+  auto check_batch = [&](const feistel_ctx& ctx, size_type n, size_type rounds, size_type count) {
+    std::vector<uint64_t> in(count), out(count), back(count);
+    check_gen.fill(in.data(), count);
+    for (auto& v : in) v &= (n == 64) ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+    ctx.encrypt_batch(in.data(), out.data(), count, rounds);
+    ctx.decrypt_batch(out.data(), back.data(), count, rounds);
+    batch_ok = batch_ok && back == in;
+    for (size_type i = 0; i < count; ++i) {
+      batch_ok = batch_ok && ctx.encrypt(bitstr(block_type(in[i]), n), rounds) == bitstr(block_type(out[i]), n);
+    }
+  };
+  check_batch(slow, 64, 16, 1000);
+  check_batch(fast, 64, 7, 1000);
+  check_batch(toy_ctx, 16, 6, 1000);
+  std::cout << "Batch encryption matches block encryption: " << batch_ok << std::endl;
+
+  // Traced encryption: every round's halves against a shorter encryption,
+  // S-Box outputs against the S-Boxes, and the batch records against it
+  bool trace_ok = true;
+  std::vector<feistel::round_trace> trace;
+  std::vector<uint64_t> trace_words(bs_in.size() * 16 * des_generic->trace_stride());
+  slow.encrypt_trace_batch(bs_in.data(), trace_words.data(), bs_in.size(), 16);
+  for (size_type i = 0; i < bs_in.size(); i += 37) {
+    bitstr pt(block_type(bs_in[i]), 64);
+    slow.encrypt_trace(pt, 16, trace);
+    for (size_type r = 0; r < 16; ++r) {
+      bitstr state = trace[r].left;
+      state += trace[r].right;
+      trace_ok = trace_ok && state == slow.encrypt(pt, r + 1).inv_permute(des_generic->fp);
+      const uint64_t* rec = trace_words.data() + (i * 16 + r) * des_generic->trace_stride();
+      trace_ok = trace_ok && rec[0] == trace[r].left.value(0, 32) && rec[1] == trace[r].right.value(0, 32);
+      for (size_type s = 0; s < 8; ++s) {
+        trace_ok = trace_ok && trace[r].sbox_out[s] == des_generic->sboxes[s][trace[r].sbox_in[s]];
+        trace_ok = trace_ok && rec[2 + s] == trace[r].sbox_in[s] && rec[10 + s] == trace[r].sbox_out[s];
+      }
+    }
+  }
+  std::cout << "Traced encryption matches round-by-round encryption: " << trace_ok << std::endl;
+
+  // Exact correlations of the 4-round toy against counting over the codebook
+  corr_exact toy_corr(toy_book, *toy);
+  std::vector<uint64_t> corr_in = {0x0001, 0x8000, 0x0f0f, 0x1234, 0xa5c3};
+  auto corr_best = toy_corr.best(corr_in);
+  std::vector<std::pair<uint64_t, uint64_t>> corr_pairs;
+  for (size_type i = 0; i < corr_in.size(); ++i) {
+    corr_pairs.push_back({corr_in[i], corr_best[i].first});
+    for (int j = 0; j < 3; ++j) corr_pairs.push_back({corr_in[i], check_gen.next() & 0xffff});
+  }
+  auto corr_fast = toy_corr.correlations(corr_pairs);
+  bool corr_ok = true;
+  for (size_type i = 0; i < corr_pairs.size(); ++i) {
+    uint64_t a = corr_pairs[i].first, b = corr_pairs[i].second;
+    int64_t count = 0;
+    for (uint64_t x = 0; x < toy_book->size(); ++x) {
+      count += (__builtin_popcountll(a & x) + __builtin_popcountll(b & toy_book->lookup(x))) % 2 ? -1 : 1;
+    }
+    corr_ok = corr_ok && toy_corr.row(a)[b] == count && corr_fast[i] == count / 65536.0 &&
+              toy_corr.correlation(bitstr(block_type(a), 16), bitstr(block_type(b), 16)) == count / 65536.0;
+  }
+  std::cout << "Exact correlations match counting: " << corr_ok << std::endl;
+
+  // Keyed linear hulls of the toy round function against the exact correlations
+  rf_corr toy_rf(*toy);
+  bool hull_ok = true;
+  for (size_type i = 0; i < corr_pairs.size(); ++i) {
+    double hull = toy_rf.hull(corr_pairs[i].first, corr_pairs[i].second, 4, *toy_ctx.sched);
+    hull_ok = hull_ok && std::fabs(hull - corr_fast[i]) < 1e-9;
+  }
+  std::cout << "Linear hulls match exact correlations: " << hull_ok << std::endl;
+
+  // Invariants of an 8-bit rotation: up to degree 2 one per orbit of
+  // monomials (x0 + ... + x7, and four quadratic ones), all holding on
+  // every input; flipping a bit after rotating makes the parity flip (c = 1)
+  auto rot8 = [](size_type x) { return ((x << 1) | (x >> 7)) & 0xff; };
+  nl_inv rot_inv(8, 2);
+  rot_inv.solve(rot8);
+  bool inv_ok = rot_inv.invariants.size() == 5;
+  for (const auto& g : rot_inv.invariants) {
+    for (size_type x = 0; x < 256; ++x) {
+      bool before = g.c, after = false;
+      for (size_type u : g.terms) {
+        before ^= (x & u) == u;
+        after ^= (rot8(x) & u) == u;
+      }
+      inv_ok = inv_ok && before == after;
+    }
+  }
+  nl_inv flip_inv(8, 1);
+  flip_inv.solve([&](size_type x) { return rot8(x) ^ 1; });
+  inv_ok = inv_ok && flip_inv.invariants.size() == 1 && flip_inv.invariants[0].c &&
+           flip_inv.invariants[0].terms == std::vector<size_type>({1, 2, 4, 8, 16, 32, 64, 128});
+  std::cout << "Nonlinear invariants of a rotation found: " << inv_ok << std::endl;
+
+  // Balanced invariants (unions of cycles covering half the inputs) against
+  // trying every subset of cycles: the identity, a rotation with repeated
+  // cycle lengths, the toy S-Box and a random 6-bit permutation
+  std::vector<uint> perm6(64);
+  for (uint x = 0; x < 64; ++x) perm6[x] = x;
+  for (uint x = 63; x > 0; --x) std::swap(perm6[x], perm6[check_gen.next() % (x + 1)]);
+  std::vector<bool_fn> cycle_fns = {
+    bool_fn(4, 4, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}),
+    bool_fn(4, 4, {0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15}),
+    bool_fn(sbox(4, 4, toy_box)),
+    bool_fn(6, 6, perm6)
+  };
+  bool balanced_ok = true;
+  for (auto& fn : cycle_fns) {
+    const auto& lens = fn.get_cycle_lengths();
+    size_type half_size = (size_type(1) << fn.in) / 2, brute = 0;
+    for (uint64_t subset = 0; subset < (uint64_t(1) << lens.size()); ++subset) {
+      size_type covered = 0;
+      for (size_type i = 0; i < lens.size(); ++i) covered += ((subset >> i) & 1) * lens[i];
+      brute += covered == half_size;
+    }
+    fn.get_balanced_invariants();
+    std::vector<uint64_t> supports;
+    for (const auto& inv : fn.balanced_invariants) {
+      size_type covered = 0;
+      for (size_type i = 0; i < lens.size(); ++i) covered += inv[i] * lens[i];
+      balanced_ok = balanced_ok && covered == half_size;
+      supports.push_back(inv.value(0, inv.bit_size));
+    }
+    std::sort(supports.begin(), supports.end());
+    balanced_ok = balanced_ok && fn.count_balanced_invariants() == brute && supports.size() == brute &&
+                  std::unique(supports.begin(), supports.end()) == supports.end();
+  }
+  std::cout << "Balanced invariants match subset enumeration: " << balanced_ok << std::endl;
+
+  // Trail search on the toy with several threads against one thread
+  trail toy_serial(*toy), toy_parallel(*toy);
+  toy_serial.upto(6, 1);
+  toy_parallel.upto(6, 4);
+  bool search_ok = toy_serial.fin_trails.size() == 6 && toy_parallel.fin_trails.size() == 6;
+  for (size_type r = 0; search_ok && r < 6; ++r) {
+    search_ok = toy_serial.fin_trails[r].curr_weight == toy_parallel.fin_trails[r].curr_weight;
+  }
+  std::cout << "Parallel trail search matches one thread: " << search_ok << std::endl;
+
+  // Trail store: both searches in, a save/map round trip, a search resumed
+  // from the mapped store, and a store refused by another cipher
+  trail_db toy_db(*toy, 3);
+  toy_db.add(toy_serial);
+  trail_adv toy_adv(*toy);
+  toy_adv.upto(4);
+  toy_db.add(toy_adv);
+  std::string db_path = "trail_db_check.tmp";
+  toy_db.save(db_path);
+  bool db_ok = toy_db.max_rounds() == 6 && toy_db.count(4) == 3;
+  {
+    trail_db loaded(db_path);
+    db_ok = db_ok && loaded.mapped() && loaded.fingerprint == toy->fingerprint() && loaded.max_rounds() == toy_db.max_rounds();
+    for (size_type r = 1; r <= toy_db.max_rounds(); ++r) {
+      db_ok = db_ok && loaded.count(r) == toy_db.count(r);
+      for (size_type i = 0; db_ok && i < toy_db.count(r); ++i) {
+        trail::round_info a = toy_db.get(r, i), b = loaded.get(r, i);
+        db_ok = loaded.weight(r, i) == toy_db.weight(r, i) && a.ip_masks == b.ip_masks &&
+                a.op_masks == b.op_masks && a.key_masks == b.key_masks && a.biases == b.biases;
+      }
+    }
+    trail resumed(*toy);
+    resumed.load(loaded);
+    resumed.upto(6);
+    for (size_type r = 0; db_ok && r < 6; ++r) {
+      db_ok = resumed.fin_trails[r].curr_weight == toy_serial.fin_trails[r].curr_weight;
+    }
+    bool refused = false;
+    try {
+      loaded.check(*des_generic);
+    }
+    catch (const std::invalid_argument&) {
+      refused = true;
+    }
+    db_ok = db_ok && refused;
+  }
+  std::remove(db_path.c_str());
+  std::cout << "Trail store survives save/load and resumes the search: " << db_ok << std::endl;
+
   // Test SM4 SBox
   size_type sm4_entries[256] = {
     0xd6, 0x90, 0xe9, 0xfe, 0xcc, 0xe1, 0x3d, 0xb7, 0x16, 0xb6, 0x14, 0xc2, 0x28, 0xfb, 0x2c, 0x05,
@@ -299,17 +722,17 @@ int main() {
   // Print cycles
   test.get_balanced_invariants();
   std::vector<bitstr> inv = test.balanced_invariants;
-  for (uint i = 0; i < test.cycles.size(); ++i) {
+  for (uint i = 0; i < test.get_cycles().size(); ++i) {
     std::cout << "Cycle " << i << ": ";
-    for (uint j = 0; j < test.cycles[i].size(); ++j) {
-      std::cout << test.cycles[i][j] << " ";
+    for (uint j = 0; j < test.get_cycles()[i].size(); ++j) {
+      std::cout << test.get_cycles()[i][j] << " ";
     }
     std::cout << std::endl;
   }
 
   // Print cycle sizes
   std::cout << "Cycle sizes: ";
-  for (const auto& cycle : test.cycles) {
+  for (const auto& cycle : test.get_cycles()) {
     std::cout << cycle.size() << " ";
   }
 